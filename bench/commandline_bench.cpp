@@ -0,0 +1,184 @@
+// benchmarks for the non-interactive paths, run as `commandline_bench [name...]`,
+// or without arguments to run all of them. results go to stderr.
+
+#include "CompletionTree.h"
+#include "commandline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// stdin is replaced with a pipe while this is alive
+class PipedStdin {
+public:
+    PipedStdin() {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            std::perror("pipe");
+            std::exit(1);
+        }
+        m_read_end = fds[0];
+        m_write_end = fds[1];
+        m_saved_stdin = dup(STDIN_FILENO);
+        dup2(m_read_end, STDIN_FILENO);
+    }
+    ~PipedStdin() {
+        close_write_end();
+        dup2(m_saved_stdin, STDIN_FILENO);
+        close(m_saved_stdin);
+        close(m_read_end);
+    }
+    int write_end() const { return m_write_end; }
+    void close_write_end() {
+        if (m_write_end >= 0) {
+            close(m_write_end);
+            m_write_end = -1;
+        }
+    }
+
+private:
+    int m_read_end;
+    int m_write_end;
+    int m_saved_stdin;
+};
+
+// reads commands from a pipe as fast as another thread can fill it, like
+// `generate_commands | program`
+void bench_piped_input() {
+    const size_t line_count = 10000000;
+    PipedStdin piped;
+    std::thread writer([&] {
+        std::string chunk;
+        size_t line = 0;
+        while (line < line_count) {
+            chunk.clear();
+            for (size_t i = 0; i < 4096 && line < line_count; ++i, ++line) {
+                chunk += "command ";
+                chunk += std::to_string(line);
+                chunk += '\n';
+            }
+            for (size_t done = 0; done < chunk.size();) {
+                const ssize_t n = ::write(piped.write_end(), chunk.data() + done, chunk.size() - done);
+                if (n <= 0) {
+                    return;
+                }
+                done += size_t(n);
+            }
+        }
+        piped.close_write_end();
+    });
+    const auto start = Clock::now();
+    size_t lines = 0;
+    size_t bytes = 0;
+    {
+        Commandline com;
+        std::vector<lk::CommandView> views;
+        while (com.wait_for_command()) {
+            views.clear();
+            com.get_command_views(views, 4096);
+            for (const auto& view : views) {
+                ++lines;
+                bytes += view.size;
+            }
+        }
+    }
+    const double elapsed = seconds_since(start);
+    writer.join();
+    std::fprintf(stderr, "piped_input: %zu lines, %zu bytes in %.3f s, %.1f M lines/s\n", lines, bytes, elapsed, double(lines) / elapsed / 1e6);
+}
+
+// how long destroying a Commandline takes while its input thread is blocked
+// reading a pipe that never delivers anything
+void bench_teardown() {
+    const int rounds = 200;
+    PipedStdin piped;
+    std::vector<double> micros;
+    for (int i = 0; i < rounds; ++i) {
+        std::unique_ptr<Commandline> com(new Commandline("> "));
+        const auto start = Clock::now();
+        com.reset();
+        micros.push_back(seconds_since(start) * 1e6);
+    }
+    std::sort(micros.begin(), micros.end());
+    std::fprintf(stderr, "teardown: %d rounds, median %.0f us, p99 %.0f us, max %.0f us\n", rounds, micros[micros.size() / 2], micros[micros.size() * 99 / 100], micros.back());
+}
+
+// registering many completions, then looking them up by prefix and fuzzily,
+// as a tab press does
+void bench_completions() {
+    const size_t candidate_count = 100000;
+    const char* parts[] = { "player", "entity", "vehicle", "weapon", "spawn", "zone", "npc", "item", "door", "light" };
+    std::vector<std::string> lines;
+    lines.reserve(candidate_count);
+    uint32_t seed = 1;
+    auto next = [&seed] {
+        seed = seed * 1664525 + 1013904223;
+        return seed >> 8;
+    };
+    for (size_t i = 0; i < candidate_count; ++i) {
+        lines.push_back(std::string("select ") + parts[next() % 10] + "_" + parts[next() % 10] + std::to_string(next() % 100000));
+    }
+    lk::CompletionTree tree;
+    auto start = Clock::now();
+    tree.add(lines);
+    // the first lookup packs the tree
+    tree.complete("", 0);
+    std::fprintf(stderr, "completions: %zu lines added and packed in %.1f ms\n", lines.size(), seconds_since(start) * 1e3);
+    const char* queries[] = { "select p", "select player_z", "select plzn", "select vehweap12", "select zzz" };
+    const int rounds = 20;
+    for (const char* query : queries) {
+        const std::string buffer = query;
+        size_t prefix_matches = 0;
+        size_t fuzzy_matches = 0;
+        start = Clock::now();
+        for (int i = 0; i < rounds; ++i) {
+            prefix_matches = tree.complete(buffer, buffer.size()).size();
+        }
+        const double prefix_us = seconds_since(start) * 1e6 / rounds;
+        start = Clock::now();
+        for (int i = 0; i < rounds; ++i) {
+            fuzzy_matches = tree.complete(buffer, buffer.size(), 100).size();
+        }
+        const double fuzzy_us = seconds_since(start) * 1e6 / rounds;
+        std::fprintf(stderr, "completions: \"%s\": prefix %zu matches in %.0f us, fuzzy %zu matches in %.0f us\n", query, prefix_matches, prefix_us, fuzzy_matches, fuzzy_us);
+    }
+}
+
+struct Bench {
+    const char* name;
+    std::function<void()> run;
+};
+}
+
+int main(int argc, char** argv) {
+    const std::vector<Bench> benches {
+        { "piped_input", bench_piped_input },
+        { "teardown", bench_teardown },
+        { "completions", bench_completions },
+    };
+    for (const auto& bench : benches) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; ++i) {
+            selected = selected || std::strcmp(argv[i], bench.name) == 0;
+        }
+        if (selected) {
+            bench.run();
+        }
+    }
+}
@@ -0,0 +1,18 @@
+#include "AutocompleteRequest.h"
+
+#include <utility>
+
+void lk::AutocompleteRequest::complete(std::vector<std::string> suggestions) const {
+    AutocompleteMailbox& mailbox = *m_state->mailbox;
+    std::lock_guard<std::mutex> guard(mailbox.mutex);
+    // outdated, cancelled or already completed
+    if (m_state->generation != mailbox.generation || m_state->cancelled.load()) {
+        return;
+    }
+    m_state->cancelled.store(true);
+    mailbox.result = std::move(suggestions);
+    mailbox.has_result = true;
+    if (mailbox.notify) {
+        mailbox.notify();
+    }
+}
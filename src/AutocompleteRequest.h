@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace lk {
+
+// where the results of a backend's autocomplete requests end up. shared with the
+// requests, since they may outlive the backend.
+struct AutocompleteMailbox {
+    std::mutex mutex;
+    // the request whose results are still wanted, older ones are discarded
+    uint64_t generation { 0 };
+    bool has_result { false };
+    std::vector<std::string> result;
+    // wakes the backend's input thread, reset when the backend is destroyed
+    std::function<void()> notify;
+};
+
+// AutocompleteRequest is what on_autocomplete_async gets for a tab press. It can be
+// completed right away, or kept and completed later from any thread while the user
+// keeps typing. As soon as the buffer changes or tab is pressed again, the request
+// is cancelled and its results would be discarded, so long-running lookups should
+// check cancelled() now and then and stop early.
+// Copies refer to the same request.
+class AutocompleteRequest {
+public:
+    // the buffer and cursor position at the time tab was pressed
+    const std::string& buffer() const { return m_state->buffer; }
+    int cursor() const { return m_state->cursor; }
+    // also true once the request was completed
+    bool cancelled() const { return m_state->cancelled.load(); }
+    // delivers the suggestions, each one a whole new buffer, like on_autocomplete
+    // returns them. only the first call has an effect.
+    void complete(std::vector<std::string> suggestions) const;
+
+private:
+    friend class InteractiveBackend;
+
+    struct State {
+        std::atomic<bool> cancelled { false };
+        uint64_t generation { 0 };
+        std::string buffer;
+        int cursor { 0 };
+        std::shared_ptr<AutocompleteMailbox> mailbox;
+    };
+
+    explicit AutocompleteRequest(std::shared_ptr<State> state)
+        : m_state(std::move(state)) { }
+
+    std::shared_ptr<State> m_state;
+};
+
+}
@@ -0,0 +1,204 @@
+#include "CompletionTree.h"
+
+#include <algorithm>
+#include <utility>
+
+lk::CompletionTree::CompletionTree()
+    : m_build_nodes(1) {
+}
+
+void lk::CompletionTree::add(const std::string& line) {
+    uint32_t node = 0;
+    size_t pos = 0;
+    while (pos < line.size()) {
+        if (line[pos] == ' ') {
+            ++pos;
+            continue;
+        }
+        size_t end = line.find(' ', pos);
+        if (end == std::string::npos) {
+            end = line.size();
+        }
+        m_word.assign(line, pos, end - pos);
+        const uint32_t next = uint32_t(m_build_nodes.size());
+        // inserts the word if it's new, otherwise finds the existing child
+        const uint32_t child = m_build_nodes[node].children.emplace(m_word, next).first->second;
+        if (child == next) {
+            m_build_nodes.emplace_back();
+        }
+        node = child;
+        pos = end;
+    }
+    m_packed = false;
+}
+
+void lk::CompletionTree::add(const std::vector<std::string>& lines) {
+    for (const auto& line : lines) {
+        add(line);
+    }
+}
+
+void lk::CompletionTree::clear() {
+    m_build_nodes.assign(1, BuildNode {});
+    m_packed = false;
+}
+
+void lk::CompletionTree::pack() {
+    m_names.clear();
+    m_nodes.assign(1, Node {});
+    m_masks.assign(1, 0);
+    // breadth first, so that the children of each node end up next to each other
+    m_nodes.reserve(m_build_nodes.size());
+    m_masks.reserve(m_build_nodes.size());
+    std::vector<std::pair<uint32_t, uint32_t>> queue { { 0, 0 } };
+    queue.reserve(m_build_nodes.size());
+    std::vector<std::pair<const std::string*, uint32_t>> children;
+    for (size_t i = 0; i < queue.size(); ++i) {
+        children.clear();
+        for (const auto& child : m_build_nodes[queue[i].first].children) {
+            children.emplace_back(&child.first, child.second);
+        }
+        std::sort(children.begin(), children.end(), [](const std::pair<const std::string*, uint32_t>& a, const std::pair<const std::string*, uint32_t>& b) {
+            return *a.first < *b.first;
+        });
+        m_nodes[queue[i].second].children_begin = uint32_t(m_nodes.size());
+        m_nodes[queue[i].second].children_size = uint32_t(children.size());
+        for (const auto& child : children) {
+            const std::string& name = *child.first;
+            Node node;
+            node.name_begin = uint32_t(m_names.size());
+            node.name_size = uint32_t(name.size());
+            m_names += name;
+            queue.emplace_back(child.second, uint32_t(m_nodes.size()));
+            m_nodes.push_back(node);
+            m_masks.push_back(FuzzyMatcher::char_mask(name.data(), name.size()));
+        }
+    }
+    ++m_generation;
+    m_packed = true;
+    m_cache_valid = false;
+}
+
+int lk::CompletionTree::compare_name(const Node& node, const char* word, size_t size) const {
+    return m_names.compare(node.name_begin, node.name_size, word, size);
+}
+
+bool lk::CompletionTree::has_prefix(const Node& node, const char* prefix, size_t size) const {
+    return node.name_size >= size && m_names.compare(node.name_begin, size, prefix, size) == 0;
+}
+
+void lk::CompletionTree::find_prefix(uint32_t& begin, uint32_t& end, const char* prefix, size_t size) const {
+    // first node that's not less than the prefix
+    uint32_t lo = begin;
+    uint32_t hi = end;
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (compare_name(m_nodes[mid], prefix, size) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    begin = lo;
+    // the nodes with the prefix follow it, up to the first one without
+    hi = end;
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (has_prefix(m_nodes[mid], prefix, size)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    end = lo;
+}
+
+bool lk::CompletionTree::find_parent(const std::string& buffer, size_t cursor, uint32_t& parent, size_t& word_begin) const {
+    // every word before the one at the cursor has to match a node exactly
+    parent = 0;
+    size_t pos = 0;
+    for (;;) {
+        while (pos < cursor && buffer[pos] == ' ') {
+            ++pos;
+        }
+        size_t word_end = pos;
+        while (word_end < cursor && buffer[word_end] != ' ') {
+            ++word_end;
+        }
+        if (word_end == cursor) {
+            break;
+        }
+        uint32_t begin = m_nodes[parent].children_begin;
+        uint32_t end = begin + m_nodes[parent].children_size;
+        find_prefix(begin, end, buffer.data() + pos, word_end - pos);
+        // the exact match sorts first among the ones it's a prefix of
+        if (begin == end || m_nodes[begin].name_size != word_end - pos) {
+            return false;
+        }
+        parent = begin;
+        pos = word_end;
+    }
+    word_begin = pos;
+    return true;
+}
+
+lk::CompletionTree::Matches lk::CompletionTree::complete(const std::string& buffer, size_t cursor, size_t fuzzy_limit) {
+    if (!m_packed) {
+        pack();
+    }
+    if (cursor > buffer.size()) {
+        cursor = buffer.size();
+    }
+    Matches matches;
+    matches.generation = m_generation;
+    uint32_t parent;
+    size_t pos;
+    if (!find_parent(buffer, cursor, parent, pos)) {
+        return matches;
+    }
+    matches.word_begin = pos;
+    const char* prefix = buffer.data() + pos;
+    const size_t size = cursor - pos;
+    if (fuzzy_limit != 0 && size != 0) {
+        complete_fuzzy(parent, prefix, size, fuzzy_limit, matches);
+        return matches;
+    }
+    uint32_t begin = m_nodes[parent].children_begin;
+    uint32_t end = begin + m_nodes[parent].children_size;
+    if (m_cache_valid && m_cached_parent == parent && size >= m_cached_prefix.size()
+        && m_cached_prefix.compare(0, std::string::npos, prefix, m_cached_prefix.size()) == 0) {
+        // the same word, only longer, can only match a subset of what it matched before
+        begin = m_cached.begin;
+        end = m_cached.end;
+    }
+    find_prefix(begin, end, prefix, size);
+    matches.begin = begin;
+    matches.end = end;
+    m_cached_parent = parent;
+    m_cached_prefix.assign(prefix, size);
+    m_cached = matches;
+    m_cache_valid = true;
+    return matches;
+}
+
+void lk::CompletionTree::complete_fuzzy(uint32_t parent, const char* word, size_t size, size_t limit, Matches& matches) {
+    const uint32_t begin = m_nodes[parent].children_begin;
+    const uint32_t end = begin + m_nodes[parent].children_size;
+    m_fuzzy.set_query(word, size);
+    auto name = [&](uint32_t index, const char*& data, size_t& name_size) {
+        data = m_names.data() + m_nodes[index].name_begin;
+        name_size = m_nodes[index].name_size;
+    };
+    m_fuzzy.rank(m_masks.data(), begin, end, name, limit, m_fuzzy_matches);
+    matches.ranked.reserve(m_fuzzy_matches.size());
+    for (const auto& match : m_fuzzy_matches) {
+        matches.ranked.push_back(match.index);
+    }
+    matches.begin = 0;
+    matches.end = uint32_t(matches.ranked.size());
+}
+
+void lk::CompletionTree::append_name(uint32_t index, std::string& out) const {
+    const Node& node = m_nodes[index];
+    out.append(m_names, node.name_begin, node.name_size);
+}
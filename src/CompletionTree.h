@@ -0,0 +1,98 @@
+#pragma once
+
+#include "FuzzyMatcher.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lk {
+
+// CompletionTree holds registered command lines as a tree of words, e.g.
+// "config reload" and "config set" share the "config" node. Lookups walk the
+// words before the cursor, then binary search the children of the last node
+// for the word being typed, and return the matches as a range of nodes, so
+// they don't allocate.
+// While adding, each node finds its children by name in a hash map, so adding
+// many siblings stays linear. After add(), the tree is packed on the next
+// lookup: all names in one string, and the children of each node contiguous and
+// sorted. Adding many lines before the next lookup packs only once.
+// With a fuzzy limit, the word being typed is matched against the children with
+// FuzzyMatcher instead, and the best matches are returned ranked.
+// Not thread-safe, the backend guards it.
+class CompletionTree {
+public:
+    struct Matches {
+        // node indices, see node()
+        uint32_t begin { 0 };
+        uint32_t end { 0 };
+        // fuzzy matches, best first. if set, [begin, end) index into this instead.
+        std::vector<uint32_t> ranked;
+        // where the completed word starts in the buffer
+        size_t word_begin { 0 };
+        // which packing of the tree these refer to
+        uint32_t generation { 0 };
+
+        bool empty() const { return begin == end; }
+        size_t size() const { return end - begin; }
+        uint32_t node(size_t i) const { return ranked.empty() ? begin + uint32_t(i) : ranked[begin + i]; }
+    };
+
+    CompletionTree();
+
+    // adds a line of space-separated words, each one a level deeper
+    void add(const std::string& line);
+    void add(const std::vector<std::string>& lines);
+    void clear();
+
+    // completions for the word that ends at `cursor`. with a `fuzzy_limit`, up to that
+    // many fuzzy matches, unless the word is empty.
+    Matches complete(const std::string& buffer, size_t cursor, size_t fuzzy_limit = 0);
+    // appends the name of node `index` to `out`
+    void append_name(uint32_t index, std::string& out) const;
+    uint32_t generation() const { return m_generation; }
+
+private:
+    struct Node {
+        uint32_t name_begin { 0 };
+        uint32_t name_size { 0 };
+        uint32_t children_begin { 0 };
+        uint32_t children_size { 0 };
+    };
+    // the tree as it's added to, packed into m_nodes by pack()
+    struct BuildNode {
+        // by name
+        std::unordered_map<std::string, uint32_t> children;
+    };
+
+    void pack();
+    // finds the node of the words before the one at `cursor`, and where that one begins
+    bool find_parent(const std::string& buffer, size_t cursor, uint32_t& parent, size_t& word_begin) const;
+    void complete_fuzzy(uint32_t parent, const char* word, size_t size, size_t limit, Matches& matches);
+    int compare_name(const Node& node, const char* word, size_t size) const;
+    bool has_prefix(const Node& node, const char* prefix, size_t size) const;
+    // narrows [begin, end), a sorted range of nodes, to the ones that start with `prefix`
+    void find_prefix(uint32_t& begin, uint32_t& end, const char* prefix, size_t size) const;
+
+    std::vector<BuildNode> m_build_nodes;
+    // the word being looked up in add(), reused
+    std::string m_word;
+    bool m_packed { false };
+    uint32_t m_generation { 0 };
+    std::string m_names;
+    // m_nodes[0] is the root
+    std::vector<Node> m_nodes;
+    // FuzzyMatcher::char_mask() of each node's name
+    std::vector<uint64_t> m_masks;
+    FuzzyMatcher m_fuzzy;
+    std::vector<FuzzyMatcher::Match> m_fuzzy_matches;
+
+    // the last lookup. typing more of the same word only searches within its matches.
+    uint32_t m_cached_parent { 0 };
+    std::string m_cached_prefix;
+    Matches m_cached;
+    bool m_cache_valid { false };
+};
+
+}
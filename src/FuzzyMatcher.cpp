@@ -0,0 +1,135 @@
+#include "FuzzyMatcher.h"
+
+namespace {
+// the same scores as fzf's v1 algorithm
+const int score_match = 16;
+const int score_gap_start = -3;
+const int score_gap_extension = -1;
+const int bonus_boundary = score_match / 2;
+const int bonus_camel = bonus_boundary + score_gap_extension;
+const int bonus_consecutive = -(score_gap_start + score_gap_extension);
+// the first character of the query counts double
+const int bonus_first_multiplier = 2;
+
+char fold(char c) {
+    return c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c;
+}
+
+bool is_lower(char c) {
+    return c >= 'a' && c <= 'z';
+}
+
+bool is_upper(char c) {
+    return c >= 'A' && c <= 'Z';
+}
+
+bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool is_word(char c) {
+    return is_lower(c) || is_upper(c) || is_digit(c);
+}
+
+// how good a place `data[i]` is for a match to start
+int bonus_at(const char* data, size_t i) {
+    if (i == 0 || !is_word(data[i - 1])) {
+        return is_word(data[i]) ? bonus_boundary : 0;
+    }
+    const char prev = data[i - 1];
+    const char c = data[i];
+    if ((is_lower(prev) && is_upper(c)) || (!is_digit(prev) && is_digit(c))) {
+        return bonus_camel;
+    }
+    return 0;
+}
+}
+
+uint64_t lk::FuzzyMatcher::char_mask(const char* data, size_t size) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < size; ++i) {
+        const unsigned char c = static_cast<unsigned char>(fold(data[i]));
+        unsigned bit;
+        if (c >= 'a' && c <= 'z') {
+            bit = c - 'a';
+        } else if (c >= '0' && c <= '9') {
+            bit = 26 + (c - '0');
+        } else {
+            // everything else shares the remaining bits, which only lets a few more
+            // candidates through to score()
+            bit = 36 + c % 28;
+        }
+        mask |= uint64_t(1) << bit;
+    }
+    return mask;
+}
+
+void lk::FuzzyMatcher::set_query(const char* data, size_t size) {
+    m_query.assign(data, size);
+    for (char& c : m_query) {
+        c = fold(c);
+    }
+    m_query_mask = char_mask(data, size);
+}
+
+bool lk::FuzzyMatcher::score(const char* data, size_t size, int& score) const {
+    const size_t n = m_query.size();
+    score = 0;
+    if (n == 0) {
+        return true;
+    }
+    // the first place where the whole query fits ends at `end`...
+    size_t q = 0;
+    size_t end = 0;
+    for (size_t i = 0; i < size && q < n; ++i) {
+        if (fold(data[i]) == m_query[q]) {
+            ++q;
+            end = i + 1;
+        }
+    }
+    if (q < n) {
+        return false;
+    }
+    // ...and scanning back from there finds the shortest match that ends there
+    size_t begin = end;
+    while (q > 0) {
+        --begin;
+        if (fold(data[begin]) == m_query[q - 1]) {
+            --q;
+        }
+    }
+    bool consecutive = false;
+    bool in_gap = false;
+    int run_bonus = 0;
+    for (size_t i = begin; i < end; ++i) {
+        if (q < n && fold(data[i]) == m_query[q]) {
+            int bonus = bonus_at(data, i);
+            if (consecutive) {
+                // a run is as good as its start
+                bonus = std::max(std::max(bonus, run_bonus), bonus_consecutive);
+            } else {
+                run_bonus = bonus;
+            }
+            score += score_match + (q == 0 ? bonus * bonus_first_multiplier : bonus);
+            ++q;
+            consecutive = true;
+            in_gap = false;
+        } else {
+            score += in_gap ? score_gap_extension : score_gap_start;
+            consecutive = false;
+            in_gap = true;
+        }
+    }
+    return true;
+}
+
+// higher score, then shorter, then the order the candidates came in
+bool lk::FuzzyMatcher::better(const Match& a, const Match& b) {
+    if (a.score != b.score) {
+        return a.score > b.score;
+    }
+    if (a.size != b.size) {
+        return a.size < b.size;
+    }
+    return a.index < b.index;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lk {
+
+// FuzzyMatcher scores candidates that contain the query as a subsequence,
+// ignoring case, similar to fzf: matches at the start of a word, after a
+// separator or at a camelCase hump, and runs of consecutive matches score
+// higher, gaps score lower.
+// rank() keeps only the best k candidates in a heap instead of sorting all of
+// them. Candidates come with a precomputed char_mask(), and one pass over the
+// masks skips those missing any of the query's characters before any
+// candidate is scored.
+class FuzzyMatcher {
+public:
+    struct Match {
+        int score { 0 };
+        uint32_t index { 0 };
+        uint32_t size { 0 };
+    };
+
+    // one bit per (case folded) character class in `data`
+    static uint64_t char_mask(const char* data, size_t size);
+
+    void set_query(const char* data, size_t size);
+    // returns false if the query isn't a subsequence of the candidate
+    bool score(const char* data, size_t size, int& score) const;
+
+    // the best `limit` of the candidates [begin, end), best first. `masks[i]` is the
+    // char_mask() of candidate i, and `name(i, data, size)` looks up its text.
+    template<typename NameOf>
+    void rank(const uint64_t* masks, uint32_t begin, uint32_t end, NameOf name, size_t limit, std::vector<Match>& out);
+
+private:
+    static bool better(const Match& a, const Match& b);
+
+    std::string m_query;
+    uint64_t m_query_mask { 0 };
+    std::vector<uint32_t> m_candidates;
+};
+
+}
+
+template<typename NameOf>
+void lk::FuzzyMatcher::rank(const uint64_t* masks, uint32_t begin, uint32_t end, NameOf name, size_t limit, std::vector<Match>& out) {
+    out.clear();
+    if (limit == 0 || begin >= end) {
+        return;
+    }
+    // branch-free, so that the compiler can vectorize it
+    m_candidates.resize(end - begin);
+    size_t count = 0;
+    for (uint32_t i = begin; i < end; ++i) {
+        m_candidates[count] = i;
+        count += (masks[i] & m_query_mask) == m_query_mask;
+    }
+    // a heap with the worst of the best `limit` matches on top
+    for (size_t i = 0; i < count; ++i) {
+        const char* data;
+        size_t size;
+        name(m_candidates[i], data, size);
+        Match match;
+        if (!score(data, size, match.score)) {
+            continue;
+        }
+        match.index = m_candidates[i];
+        match.size = uint32_t(size);
+        if (out.size() < limit) {
+            out.push_back(match);
+            std::push_heap(out.begin(), out.end(), better);
+        } else if (better(match, out.front())) {
+            std::pop_heap(out.begin(), out.end(), better);
+            out.back() = match;
+            std::push_heap(out.begin(), out.end(), better);
+        }
+    }
+    std::sort_heap(out.begin(), out.end(), better);
+}
+
@@ -0,0 +1,205 @@
+#include "History.h"
+
+#include <algorithm>
+
+namespace {
+// the `n` bytes at p (1 to 3), tagged with n so that "ab" and "\0ab" differ
+uint32_t ngram(const char* p, size_t n) {
+    uint32_t key = uint32_t(n) << 24;
+    for (size_t i = 0; i < n; ++i) {
+        key |= uint32_t(uint8_t(p[i])) << (8 * (n - 1 - i));
+    }
+    return key;
+}
+}
+
+void lk::History::set_limits(size_t max_entries, size_t max_bytes) {
+    m_max_entries = max_entries;
+    m_max_bytes = max_bytes;
+    while (!empty() && over_limit(0, 0)) {
+        pop_oldest();
+    }
+}
+
+bool lk::History::over_limit(size_t extra_entries, size_t extra_bytes) const {
+    return (m_max_entries != 0 && m_size + extra_entries > m_max_entries)
+        || (m_max_bytes != 0 && m_bytes + extra_bytes > m_max_bytes);
+}
+
+bool lk::History::push(const char* data, size_t size) {
+    if (m_ignore_duplicates && !empty() && at(m_size - 1).compare(0, std::string::npos, data, size) == 0) {
+        return false;
+    }
+    if (m_max_bytes != 0 && size > m_max_bytes) {
+        // would evict everything and still not fit
+        return false;
+    }
+    while (!empty() && over_limit(1, size)) {
+        pop_oldest();
+    }
+    if (m_size == m_slots.size()) {
+        grow();
+    }
+    // assign() reuses the capacity of whatever was evicted from this slot
+    m_slots[(m_begin + m_size) % m_slots.size()].assign(data, size);
+    if (m_indexed) {
+        index_entry(m_first_id + uint32_t(m_size), data, size);
+    }
+    ++m_size;
+    m_bytes += size;
+    return true;
+}
+
+void lk::History::pop_oldest() {
+    // the string is left as it is, so that its buffer can be reused
+    const std::string& oldest = m_slots[m_begin];
+    if (m_indexed) {
+        unindex_entry(m_first_id, oldest.data(), oldest.size());
+    }
+    ++m_first_id;
+    m_bytes -= oldest.size();
+    m_begin = (m_begin + 1) % m_slots.size();
+    --m_size;
+}
+
+void lk::History::grow() {
+    size_t capacity = m_slots.empty() ? 16 : m_slots.size() * 2;
+    if (m_max_entries != 0 && capacity > m_max_entries) {
+        capacity = m_max_entries;
+    }
+    // unwrap into a new ring, oldest first
+    std::vector<std::string> slots(capacity);
+    for (size_t i = 0; i < m_size; ++i) {
+        slots[i].swap(m_slots[(m_begin + i) % m_slots.size()]);
+    }
+    m_slots.swap(slots);
+    m_begin = 0;
+}
+
+void lk::History::clear() {
+    m_slots.clear();
+    m_begin = 0;
+    m_size = 0;
+    m_bytes = 0;
+    m_short_grams.clear();
+    m_trigrams.clear();
+    m_indexed = false;
+    m_first_id = 0;
+}
+
+std::vector<std::string> lk::History::to_vector() const {
+    std::vector<std::string> result;
+    result.reserve(m_size);
+    for (size_t i = 0; i < m_size; ++i) {
+        result.push_back(at(i));
+    }
+    return result;
+}
+
+void lk::History::index_entry(uint32_t id, const char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        for (size_t n = 1; n <= 3 && i + n <= size; ++n) {
+            Postings& list = postings(ngram(data + i, n));
+            // each entry is listed once per n-gram, however often it contains it
+            if (list.ids.size() == list.begin || list.ids.back() != id) {
+                list.ids.push_back(id);
+            }
+        }
+    }
+}
+
+void lk::History::unindex_entry(uint32_t id, const char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        for (size_t n = 1; n <= 3 && i + n <= size; ++n) {
+            const uint32_t gram = ngram(data + i, n);
+            Postings* list = find_postings(gram);
+            // the oldest entry is at the front of each of its lists, and the
+            // check skips n-grams that occur more than once
+            if (!list || list->begin == list->ids.size() || list->ids[list->begin] != id) {
+                continue;
+            }
+            ++list->begin;
+            if (list->begin == list->ids.size()) {
+                if (gram >> 24 == 3) {
+                    m_trigrams.erase(gram);
+                } else {
+                    list->ids.clear();
+                    list->begin = 0;
+                }
+            } else if (list->begin > 16 && list->begin * 2 > list->ids.size()) {
+                list->ids.erase(list->ids.begin(), list->ids.begin() + std::ptrdiff_t(list->begin));
+                list->begin = 0;
+            }
+        }
+    }
+}
+
+// 1 and 2-grams live in a flat table, only trigrams are hashed
+lk::History::Postings& lk::History::postings(uint32_t gram) {
+    switch (gram >> 24) {
+    case 1:
+        return m_short_grams[gram & 0xff];
+    case 2:
+        return m_short_grams[256 + (gram & 0xffff)];
+    default:
+        return m_trigrams[gram];
+    }
+}
+
+lk::History::Postings* lk::History::find_postings(uint32_t gram) {
+    if (gram >> 24 != 3) {
+        return &postings(gram);
+    }
+    auto it = m_trigrams.find(gram);
+    return it == m_trigrams.end() ? nullptr : &it->second;
+}
+
+void lk::History::build_index() {
+    m_short_grams.assign(256 + 256 * 256, Postings {});
+    m_trigrams.clear();
+    for (size_t i = 0; i < m_size; ++i) {
+        const std::string& entry = at(i);
+        index_entry(m_first_id + uint32_t(i), entry.data(), entry.size());
+    }
+    m_indexed = true;
+}
+
+size_t lk::History::search(const std::string& needle, size_t before) {
+    if (before > m_size) {
+        before = m_size;
+    }
+    if (needle.empty()) {
+        return npos;
+    }
+    if (!m_indexed) {
+        build_index();
+    }
+    // every match contains all of the needle's trigrams (or the whole needle, if
+    // it's shorter than that), so the candidates are the entries in the shortest
+    // of their lists
+    const size_t n = needle.size() < 3 ? needle.size() : 3;
+    const Postings* rarest = nullptr;
+    for (size_t i = 0; i + n <= needle.size(); ++i) {
+        const Postings* list = find_postings(ngram(needle.data() + i, n));
+        if (!list || list->begin == list->ids.size()) {
+            return npos;
+        }
+        if (!rarest || list->ids.size() - list->begin < rarest->ids.size() - rarest->begin) {
+            rarest = list;
+        }
+    }
+    const uint32_t first_id = m_first_id;
+    auto begin = rarest->ids.begin() + std::ptrdiff_t(rarest->begin);
+    // ids are compared relative to the oldest one, so that wrapping around is harmless
+    auto it = std::lower_bound(begin, rarest->ids.end(), before, [&](uint32_t id, size_t index) {
+        return size_t(id - first_id) < index;
+    });
+    while (it != begin) {
+        --it;
+        const size_t index = size_t(*it - first_id);
+        if (at(index).find(needle) != std::string::npos) {
+            return index;
+        }
+    }
+    return npos;
+}
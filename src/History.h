@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lk {
+
+// History is a ring of command strings, oldest first. Adding an entry when a
+// limit is reached evicts the oldest one in O(1), and the evicted slot's string
+// is reused for the new entry, so a full history doesn't allocate per command.
+// search() is backed by an index of every 1, 2 and 3 byte sequence (n-gram) in
+// the entries, which is built on the first search
+// and from then on kept up to date by push() and eviction.
+// Not thread-safe, the backend guards it.
+class History {
+public:
+    // limits of 0 mean unlimited
+    void set_limits(size_t max_entries, size_t max_bytes);
+    size_t max_entries() const { return m_max_entries; }
+    size_t max_bytes() const { return m_max_bytes; }
+    // if set, an entry equal to the newest one is not added again
+    void set_ignore_duplicates(bool ignore) { m_ignore_duplicates = ignore; }
+
+    // returns false if the entry was ignored as a duplicate, or is larger than the byte limit
+    bool push(const std::string& entry) { return push(entry.data(), entry.size()); }
+    bool push(const char* data, size_t size);
+    void clear();
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    // total length of all entries
+    size_t bytes() const { return m_bytes; }
+    // 0 is the oldest entry
+    const std::string& at(size_t i) const { return m_slots[(m_begin + i) % m_slots.size()]; }
+    std::vector<std::string> to_vector() const;
+
+    static const size_t npos = size_t(-1);
+    // the index of the newest entry before `before` that contains `needle`, or npos
+    size_t search(const std::string& needle, size_t before);
+
+private:
+    // ids of the entries that contain an n-gram, ascending. ids before `begin` were
+    // evicted, they're erased in bulk once they make up half the list.
+    struct Postings {
+        std::vector<uint32_t> ids;
+        size_t begin { 0 };
+    };
+
+    void pop_oldest();
+    void grow();
+    bool over_limit(size_t extra_entries, size_t extra_bytes) const;
+    void build_index();
+    void index_entry(uint32_t id, const char* data, size_t size);
+    void unindex_entry(uint32_t id, const char* data, size_t size);
+    Postings& postings(uint32_t gram);
+    Postings* find_postings(uint32_t gram);
+
+    // m_slots[m_begin] is the oldest entry, m_size entries follow it (wrapping around)
+    std::vector<std::string> m_slots;
+    size_t m_begin { 0 };
+    size_t m_size { 0 };
+    size_t m_bytes { 0 };
+    size_t m_max_entries { 0 };
+    size_t m_max_bytes { 0 };
+    bool m_ignore_duplicates { false };
+
+    // every entry gets the next id when it's pushed, so at(i) has the id m_first_id + i
+    uint32_t m_first_id { 0 };
+    bool m_indexed { false };
+    // see postings()
+    std::vector<Postings> m_short_grams;
+    std::unordered_map<uint32_t, Postings> m_trigrams;
+};
+
+}
@@ -0,0 +1,290 @@
+#include "KeyDecoder.h"
+
+#include <cstring>
+
+namespace {
+
+struct KeyTables {
+    // CSI sequences by final byte, e.g. ESC [ A
+    lk::Key csi_final[128];
+    // CSI sequences terminated with '~' by their first parameter, e.g. ESC [ 3 ~
+    lk::Key csi_tilde[32];
+    // SS3 sequences by final byte, e.g. ESC O H
+    lk::Key ss3_final[128];
+    // windows console scan codes following a 0x00 or 0xe0 prefix
+    lk::Key win_scan[256];
+    uint8_t win_scan_mods[256];
+
+    KeyTables() {
+        for (auto& k : csi_final) {
+            k = lk::Key::Unknown;
+        }
+        for (auto& k : csi_tilde) {
+            k = lk::Key::Unknown;
+        }
+        for (auto& k : ss3_final) {
+            k = lk::Key::Unknown;
+        }
+        for (size_t i = 0; i < 256; ++i) {
+            win_scan[i] = lk::Key::Unknown;
+            win_scan_mods[i] = lk::ModNone;
+        }
+
+        csi_final['A'] = ss3_final['A'] = lk::Key::Up;
+        csi_final['B'] = ss3_final['B'] = lk::Key::Down;
+        csi_final['C'] = ss3_final['C'] = lk::Key::Right;
+        csi_final['D'] = ss3_final['D'] = lk::Key::Left;
+        csi_final['H'] = ss3_final['H'] = lk::Key::Home;
+        csi_final['F'] = ss3_final['F'] = lk::Key::End;
+        csi_final['Z'] = lk::Key::BackTab;
+        ss3_final['M'] = lk::Key::Enter; // keypad enter
+
+        csi_tilde[1] = lk::Key::Home;
+        csi_tilde[2] = lk::Key::Insert;
+        csi_tilde[3] = lk::Key::Delete;
+        csi_tilde[4] = lk::Key::End;
+        csi_tilde[5] = lk::Key::PageUp;
+        csi_tilde[6] = lk::Key::PageDown;
+        csi_tilde[7] = lk::Key::Home;
+        csi_tilde[8] = lk::Key::End;
+
+        win_scan['H'] = lk::Key::Up;
+        win_scan['P'] = lk::Key::Down;
+        win_scan['K'] = lk::Key::Left;
+        win_scan['M'] = lk::Key::Right;
+        win_scan[0x47] = lk::Key::Home;
+        win_scan[0x4f] = lk::Key::End;
+        win_scan[0x49] = lk::Key::PageUp;
+        win_scan[0x51] = lk::Key::PageDown;
+        win_scan[0x52] = lk::Key::Insert;
+        win_scan[0x53] = lk::Key::Delete;
+        win_scan[0x73] = lk::Key::Left;
+        win_scan_mods[0x73] = lk::ModCtrl;
+        win_scan[0x74] = lk::Key::Right;
+        win_scan_mods[0x74] = lk::ModCtrl;
+        win_scan[0x77] = lk::Key::Home;
+        win_scan_mods[0x77] = lk::ModCtrl;
+        win_scan[0x75] = lk::Key::End;
+        win_scan_mods[0x75] = lk::ModCtrl;
+        win_scan[0x8d] = lk::Key::Up;
+        win_scan_mods[0x8d] = lk::ModCtrl;
+        win_scan[0x91] = lk::Key::Down;
+        win_scan_mods[0x91] = lk::ModCtrl;
+    }
+};
+
+const KeyTables s_tables;
+
+const char s_paste_end[] = "\x1b[201~";
+const size_t s_paste_end_size = sizeof(s_paste_end) - 1;
+
+lk::KeyEvent make_event(lk::Key key, uint8_t mods = lk::ModNone, char ch = 0) {
+    lk::KeyEvent event;
+    event.key = key;
+    event.mods = mods;
+    event.ch = ch;
+    return event;
+}
+
+}
+
+lk::KeyDecoder::KeyDecoder(bool windows_scan_codes)
+    : m_windows_scan_codes(windows_scan_codes) {
+}
+
+void lk::KeyDecoder::feed(const char* data, size_t size, std::vector<KeyEvent>& out) {
+    size_t i = 0;
+    while (i < size) {
+        if (m_state == State::Paste) {
+            i += feed_paste(data + i, size - i, out);
+        } else {
+            feed_byte(static_cast<unsigned char>(data[i]), out);
+            ++i;
+        }
+    }
+}
+
+void lk::KeyDecoder::flush(std::vector<KeyEvent>& out) {
+    if (m_state == State::Paste) {
+        return;
+    } else if (m_state == State::Escape) {
+        out.push_back(make_event(Key::Escape));
+    } else if (m_state != State::Ground) {
+        // an incomplete sequence timed out, there's nothing sensible to report
+        out.push_back(make_event(Key::Unknown));
+    }
+    reset();
+}
+
+void lk::KeyDecoder::reset() {
+    m_state = State::Ground;
+    m_param_count = 0;
+    m_csi_private = false;
+    m_paste.clear();
+    m_paste_match = 0;
+}
+
+void lk::KeyDecoder::feed_byte(unsigned char c, std::vector<KeyEvent>& out) {
+    switch (m_state) {
+    case State::Ground:
+        ground(c, out);
+        break;
+    case State::Escape:
+        if (c == '[') {
+            m_state = State::Csi;
+            m_param_count = 0;
+            m_csi_private = false;
+        } else if (c == 'O') {
+            m_state = State::Ss3;
+        } else if (c == 0x1b) {
+            // ESC ESC: report the first one, the second starts a new sequence
+            out.push_back(make_event(Key::Escape));
+        } else if (c >= 0x20 && c < 0x7f) {
+            out.push_back(make_event(Key::Char, ModAlt, char(c)));
+            m_state = State::Ground;
+        } else {
+            out.push_back(make_event(Key::Escape));
+            m_state = State::Ground;
+            ground(c, out);
+        }
+        break;
+    case State::Csi:
+        if (c >= '0' && c <= '9') {
+            if (m_param_count == 0) {
+                m_param_count = 1;
+                m_params[0] = 0;
+            }
+            uint16_t& param = m_params[m_param_count - 1];
+            if (param < 10000) {
+                param = uint16_t(param * 10 + (c - '0'));
+            }
+        } else if (c == ';') {
+            if (m_param_count == 0) {
+                m_params[m_param_count++] = 0;
+            }
+            if (m_param_count < max_params) {
+                m_params[m_param_count++] = 0;
+            }
+        } else if (c >= 0x3c && c <= 0x3f) {
+            // private parameter prefix, e.g. mouse or mode reports
+            m_csi_private = true;
+        } else if (c >= 0x20 && c <= 0x2f) {
+            // intermediate bytes carry nothing we decode
+        } else if (c >= 0x40 && c <= 0x7e) {
+            m_state = State::Ground;
+            finish_csi(c, out);
+            if (m_state != State::Paste) {
+                reset();
+            }
+        } else {
+            // not valid inside a CSI sequence, so abort it
+            out.push_back(make_event(Key::Unknown));
+            reset();
+            ground(c, out);
+        }
+        break;
+    case State::Ss3:
+        if (c < 128) {
+            out.push_back(make_event(s_tables.ss3_final[c]));
+        } else {
+            out.push_back(make_event(Key::Unknown));
+        }
+        m_state = State::Ground;
+        break;
+    case State::WinScan:
+        out.push_back(make_event(s_tables.win_scan[c], s_tables.win_scan_mods[c]));
+        m_state = State::Ground;
+        break;
+    case State::Paste:
+        // handled in bulk by feed_paste()
+        break;
+    }
+}
+
+void lk::KeyDecoder::ground(unsigned char c, std::vector<KeyEvent>& out) {
+    if (c == 0x1b) {
+        m_state = State::Escape;
+    } else if (m_windows_scan_codes && (c == 0x00 || c == 0xe0)) {
+        m_state = State::WinScan;
+    } else if (c == '\r' || c == '\n') {
+        out.push_back(make_event(Key::Enter));
+    } else if (c == '\t') {
+        out.push_back(make_event(Key::Tab));
+    } else if (c == '\b' || c == 0x7f) {
+        out.push_back(make_event(Key::Backspace));
+    } else if (c == 0x00) {
+        out.push_back(make_event(Key::Char, ModCtrl, '@'));
+    } else if (c < 0x1b) {
+        out.push_back(make_event(Key::Char, ModCtrl, char('a' + c - 1)));
+    } else if (c < 0x20) {
+        out.push_back(make_event(Key::Unknown));
+    } else {
+        out.push_back(make_event(Key::Char, ModNone, char(c)));
+    }
+}
+
+void lk::KeyDecoder::finish_csi(unsigned char final_byte, std::vector<KeyEvent>& out) {
+    if (m_csi_private) {
+        out.push_back(make_event(Key::Unknown));
+        return;
+    }
+    if (final_byte == '~' && m_param_count > 0 && m_params[0] == 200) {
+        m_state = State::Paste;
+        m_paste.clear();
+        m_paste_match = 0;
+        return;
+    }
+    Key key = Key::Unknown;
+    if (final_byte == '~') {
+        if (m_param_count > 0 && m_params[0] < sizeof(s_tables.csi_tilde) / sizeof(*s_tables.csi_tilde)) {
+            key = s_tables.csi_tilde[m_params[0]];
+        }
+    } else if (final_byte < 128) {
+        key = s_tables.csi_final[final_byte];
+    }
+    uint8_t mods = ModNone;
+    // xterm style modifiers: ESC [ 1 ; <1 + mods> C
+    if (m_param_count >= 2 && m_params[1] > 1) {
+        mods = uint8_t((m_params[1] - 1) & (ModShift | ModAlt | ModCtrl));
+    }
+    if (key == Key::BackTab) {
+        mods |= ModShift;
+    }
+    out.push_back(make_event(key, mods));
+}
+
+size_t lk::KeyDecoder::feed_paste(const char* data, size_t size, std::vector<KeyEvent>& out) {
+    size_t i = 0;
+    while (i < size) {
+        if (m_paste_match == 0) {
+            // copy everything up to the next ESC in one go
+            const void* esc = std::memchr(data + i, 0x1b, size - i);
+            size_t end = esc ? size_t(static_cast<const char*>(esc) - data) : size;
+            m_paste.append(data + i, end - i);
+            i = end;
+            if (i == size) {
+                break;
+            }
+        }
+        if (data[i] == s_paste_end[m_paste_match]) {
+            ++i;
+            if (++m_paste_match == s_paste_end_size) {
+                KeyEvent event = make_event(Key::Paste);
+                event.text.swap(m_paste);
+                out.push_back(std::move(event));
+                reset();
+                return i;
+            }
+        } else {
+            // false alarm, the partial marker was part of the pasted text.
+            // the marker contains only one ESC, so matching restarts at this byte.
+            m_paste.append(s_paste_end, m_paste_match);
+            m_paste_match = 0;
+            if (data[i] != 0x1b) {
+                m_paste.push_back(data[i]);
+                ++i;
+            }
+        }
+    }
+    return i;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lk {
+
+enum class Key : uint8_t {
+    Unknown,
+    Char, // printable or control character, see KeyEvent::ch
+    Enter,
+    Tab,
+    BackTab,
+    Backspace,
+    Delete,
+    Insert,
+    Up,
+    Down,
+    Left,
+    Right,
+    Home,
+    End,
+    PageUp,
+    PageDown,
+    Escape,
+    Paste, // a complete bracketed paste, see KeyEvent::text
+};
+
+// bitflags, same layout as the xterm modifier parameter minus one
+enum KeyModifier : uint8_t {
+    ModNone = 0,
+    ModShift = 1,
+    ModAlt = 2,
+    ModCtrl = 4,
+};
+
+struct KeyEvent {
+    Key key { Key::Unknown };
+    uint8_t mods { ModNone };
+    // the character for Key::Char. control characters are reported as
+    // their letter with ModCtrl set, so Ctrl+R is { Key::Char, ModCtrl, 'r' }
+    char ch { 0 };
+    // the pasted bytes for Key::Paste, verbatim
+    std::string text;
+};
+
+// KeyDecoder turns raw terminal input bytes into key events. It is a pure
+// state machine over bytes and does not touch the terminal, so it can be fed
+// from any byte source. Incomplete sequences stay pending across feed() calls;
+// when no further byte arrives within the escape timeout, the caller should
+// call flush(), which resolves a lone ESC into Key::Escape.
+// Bracketed pastes (ESC [ 200 ~ ... ESC [ 201 ~) are collected in bulk and
+// reported as a single Key::Paste event once the end marker arrives.
+class KeyDecoder {
+public:
+    // windows_scan_codes enables decoding of the 0x00/0xe0 prefixed scan codes
+    // returned by _getch(), instead of treating those bytes as characters.
+    explicit KeyDecoder(bool windows_scan_codes = false);
+
+    void feed(const char* data, size_t size, std::vector<KeyEvent>& out);
+    void flush(std::vector<KeyEvent>& out);
+    // true while an escape sequence is incomplete. an unfinished paste does not
+    // count, as its end marker may legitimately take a while to arrive.
+    bool pending() const { return m_state != State::Ground && m_state != State::Paste; }
+    void reset();
+
+private:
+    enum class State : uint8_t {
+        Ground,
+        Escape,
+        Csi,
+        Ss3,
+        WinScan,
+        Paste,
+    };
+
+    void feed_byte(unsigned char c, std::vector<KeyEvent>& out);
+    void ground(unsigned char c, std::vector<KeyEvent>& out);
+    void finish_csi(unsigned char final_byte, std::vector<KeyEvent>& out);
+    size_t feed_paste(const char* data, size_t size, std::vector<KeyEvent>& out);
+
+    static constexpr size_t max_params = 4;
+
+    bool m_windows_scan_codes;
+    State m_state { State::Ground };
+    uint16_t m_params[max_params] {};
+    size_t m_param_count { 0 };
+    bool m_csi_private { false };
+    std::string m_paste;
+    // how much of the paste end marker has been matched so far
+    size_t m_paste_match { 0 };
+};
+
+}
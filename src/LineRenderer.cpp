@@ -0,0 +1,146 @@
+#include "LineRenderer.h"
+
+#include <cstdio>
+
+namespace {
+// placeholders for the scroll markers in a frame, one column each
+const char scroll_left_marker = '\x01';
+const char scroll_right_marker = '\x02';
+// below this many unchanged characters after an edit, rewriting them is
+// cheaper than shifting them with insert/delete character sequences
+const size_t min_shift_suffix = 4;
+
+void append_csi(std::string& out, size_t n, char final) {
+    char seq[32];
+    int len = snprintf(seq, sizeof(seq), "\x1b[%zu%c", n, final);
+    out.append(seq, size_t(len));
+}
+}
+
+lk::LineRenderer::LineRenderer() {
+    m_frame.reserve(256);
+    m_drawn.reserve(256);
+}
+
+void lk::LineRenderer::cleared() {
+    m_drawn.clear();
+    m_drawn_prompt.clear();
+    m_drawn_cursor = 0;
+    m_valid = true;
+}
+
+void lk::LineRenderer::invalidate() {
+    m_valid = false;
+}
+
+void lk::LineRenderer::build_frame(const std::string& prompt, const std::string& buffer, size_t cursor, size_t width) {
+    m_frame.clear();
+    // leaves room for a scroll marker and the cursor behind the last character, and
+    // keeps the last column free: a terminal doesn't move the cursor past it, but
+    // leaves it on it until the next character wraps, so relative moves from there
+    // would be off by one
+    const size_t view = width > prompt.size() + 4 ? width - prompt.size() - 3 : 1;
+    const size_t offset = cursor < view ? 0 : cursor - view;
+    if (buffer.size() > view) {
+        size_t count = view;
+        if (offset > 0) {
+            m_frame += scroll_left_marker;
+        } else {
+            ++count;
+        }
+        m_frame.append(buffer, offset, count);
+        if (offset + view < buffer.size()) {
+            m_frame += scroll_right_marker;
+        }
+    } else {
+        m_frame += buffer;
+    }
+    m_frame_cursor = cursor - offset + (offset > 0 ? 1 : 0);
+}
+
+void lk::LineRenderer::append_cells(std::string& out, size_t begin, size_t end) const {
+    for (size_t i = begin; i < end;) {
+        const char c = m_frame[i];
+        if (c == scroll_left_marker) {
+            out += "\x1b[7m<\x1b[0m";
+            ++i;
+        } else if (c == scroll_right_marker) {
+            out += "\x1b[7m>\x1b[0m";
+            ++i;
+        } else {
+            // runs of plain characters in one go
+            size_t run = i + 1;
+            while (run < end && m_frame[run] != scroll_left_marker && m_frame[run] != scroll_right_marker) {
+                ++run;
+            }
+            out.append(m_frame, i, run - i);
+            i = run;
+        }
+    }
+}
+
+void lk::LineRenderer::move_cursor(std::string& out, size_t to) {
+    if (to == m_drawn_cursor) {
+        return;
+    } else if (to + 1 == m_drawn_cursor) {
+        out += '\b';
+    } else if (to < m_drawn_cursor) {
+        append_csi(out, m_drawn_cursor - to, 'D');
+    } else {
+        append_csi(out, to - m_drawn_cursor, 'C');
+    }
+    m_drawn_cursor = to;
+}
+
+void lk::LineRenderer::render(const std::string& prompt, const std::string& buffer, size_t cursor, size_t width, std::string& out) {
+    build_frame(prompt, buffer, cursor, width);
+    const size_t base = prompt.size();
+    if (!m_valid || prompt != m_drawn_prompt) {
+        // a cleared line is already empty, anything else is redrawn from scratch
+        if (!m_valid || !m_drawn.empty() || !m_drawn_prompt.empty()) {
+            out += "\x1b[2K\x1b[0G";
+        }
+        out += prompt;
+        append_cells(out, 0, m_frame.size());
+        m_drawn_cursor = base + m_frame.size();
+        m_drawn_prompt = prompt;
+        m_valid = true;
+    } else {
+        const size_t min = m_frame.size() < m_drawn.size() ? m_frame.size() : m_drawn.size();
+        size_t prefix = 0;
+        while (prefix < min && m_frame[prefix] == m_drawn[prefix]) {
+            ++prefix;
+        }
+        size_t suffix = 0;
+        while (suffix < min - prefix && m_frame[m_frame.size() - 1 - suffix] == m_drawn[m_drawn.size() - 1 - suffix]) {
+            ++suffix;
+        }
+        const size_t old_mid = m_drawn.size() - prefix - suffix;
+        const size_t new_mid = m_frame.size() - prefix - suffix;
+        if (old_mid != 0 || new_mid != 0) {
+            move_cursor(out, base + prefix);
+            if (old_mid == new_mid) {
+                append_cells(out, prefix, prefix + new_mid);
+                m_drawn_cursor += new_mid;
+            } else if (suffix >= min_shift_suffix) {
+                // shift the unchanged end of the line instead of rewriting it
+                if (new_mid > old_mid) {
+                    append_csi(out, new_mid - old_mid, '@');
+                    append_cells(out, prefix, prefix + new_mid);
+                } else {
+                    append_cells(out, prefix, prefix + new_mid);
+                    append_csi(out, old_mid - new_mid, 'P');
+                }
+                m_drawn_cursor += new_mid;
+            } else {
+                append_cells(out, prefix, m_frame.size());
+                m_drawn_cursor = base + m_frame.size();
+                if (m_drawn.size() > m_frame.size()) {
+                    out += "\x1b[K";
+                }
+            }
+        }
+    }
+    move_cursor(out, base + m_frame_cursor);
+    m_drawn.swap(m_frame);
+}
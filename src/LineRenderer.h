@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace lk {
+
+// LineRenderer draws the prompt line (prompt, horizontally scrolled input buffer,
+// cursor) and remembers what it drew last, so that the next frame only sends
+// what changed: typing a character sends that character, backspace sends a
+// cursor move and an erase, cursor movement sends only the move. A full redraw
+// only happens after invalidate(), or when the prompt changes.
+// Like the rest of the backend, it assumes one byte is one column.
+class LineRenderer {
+public:
+    LineRenderer();
+
+    // appends the escape sequences that turn the last frame into this one to `out`.
+    // appends nothing if nothing changed.
+    void render(const std::string& prompt, const std::string& buffer, size_t cursor, size_t width, std::string& out);
+    // the line was cleared and the cursor is in column 0, e.g. after writing output above it
+    void cleared();
+    // the state of the line is unknown (e.g. after a resize), so the next frame is drawn in full
+    void invalidate();
+    // where the cursor is on the line now, counting from 0
+    size_t cursor_column() const { return m_drawn_cursor; }
+
+private:
+    void build_frame(const std::string& prompt, const std::string& buffer, size_t cursor, size_t width);
+    void append_cells(std::string& out, size_t begin, size_t end) const;
+    void move_cursor(std::string& out, size_t to);
+
+    // the visible part of the buffer, one byte per column, with the scroll
+    // markers as placeholder bytes (see append_cells())
+    std::string m_frame;
+    size_t m_frame_cursor { 0 };
+    // what's on the screen right now. m_drawn starts at the end of the prompt, the
+    // cursor is the column on the line, counting from 0.
+    std::string m_drawn;
+    std::string m_drawn_prompt;
+    size_t m_drawn_cursor { 0 };
+    bool m_valid { false };
+};
+
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+namespace lk {
+
+// MpscQueue is an unbounded, lock-free multi-producer single-consumer FIFO
+// (an intrusive linked list after Dmitry Vyukov's design). push() may be
+// called from any thread and never blocks or takes a lock; it costs one
+// atomic exchange, plus taking a node off the free list. pop() and empty()
+// must only be called from the single consumer thread.
+// An element that is mid-push can briefly be invisible to the consumer;
+// the producer is responsible for waking the consumer after push() returns.
+//
+// Nodes are allocated in chunks and recycled through a lock-free free list
+// (a Treiber stack of node indices, tagged against ABA), so once the queue has
+// been as long as it gets, pushing no longer allocates. Values are recycled
+// along with their nodes: pop() swaps the element with the value passed in,
+// which goes back to the pool, and push_into() lets the producer reuse it
+// (e.g. a string's buffer).
+template<typename T>
+class MpscQueue {
+public:
+    MpscQueue() {
+        for (auto& chunk : m_chunks) {
+            chunk.store(nullptr, std::memory_order_relaxed);
+        }
+        Node* dummy = allocate();
+        m_head.store(dummy);
+        m_tail = dummy;
+    }
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    ~MpscQueue() {
+        T discard;
+        while (pop(discard)) {
+        }
+        if (m_tail->index == no_index) {
+            delete m_tail;
+        }
+        for (auto& chunk : m_chunks) {
+            delete[] chunk.load(std::memory_order_relaxed);
+        }
+    }
+
+    void push(T&& value) {
+        push_into([&](T& slot) { slot = std::move(value); });
+    }
+
+    // `fill(T&)` sets up the new element in place, starting from a recycled value
+    template<typename Fill>
+    void push_into(Fill fill) {
+        Node* node = allocate();
+        fill(node->value);
+        Node* prev = m_head.exchange(node, std::memory_order_acq_rel);
+        // seq_cst, so that a consumer checking empty() after announcing that it
+        // is going to sleep is guaranteed to see this element, see InteractiveBackend::write
+        prev->next.store(node);
+    }
+
+    // consumer only. swaps the element with `out`, whose old value is recycled.
+    bool pop(T& out) {
+        Node* tail = m_tail;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next) {
+            return false;
+        }
+        // `next` becomes the new dummy node, holding on to the old value of `out`
+        // until it's popped past in turn and goes back to the pool
+        using std::swap;
+        swap(out, next->value);
+        m_tail = next;
+        release(tail);
+        return true;
+    }
+
+    // consumer only
+    bool empty() const {
+        return m_tail->next.load() == nullptr;
+    }
+
+private:
+    static const uint32_t no_index = 0xffffffff;
+    static const uint32_t chunk_size = 256;
+    // past this many pooled nodes, nodes are allocated one by one and not recycled
+    static const uint32_t max_chunks = 1024;
+
+    struct Node {
+        std::atomic<Node*> next { nullptr };
+        // the node below this one on the free list
+        std::atomic<uint32_t> next_free { no_index };
+        // no_index for nodes allocated on their own
+        uint32_t index { no_index };
+        T value {};
+    };
+
+    // the free list's top is an index and a tag, which changes on every update
+    static uint64_t pack(uint32_t index, uint32_t tag) {
+        return uint64_t(tag) << 32 | index;
+    }
+    static uint32_t index_of(uint64_t top) {
+        return uint32_t(top);
+    }
+    static uint32_t tag_of(uint64_t top) {
+        return uint32_t(top >> 32);
+    }
+
+    Node* node_at(uint32_t index) const {
+        return m_chunks[index / chunk_size].load(std::memory_order_acquire) + index % chunk_size;
+    }
+
+    Node* allocate() {
+        for (;;) {
+            uint64_t top = m_free.load(std::memory_order_acquire);
+            while (index_of(top) != no_index) {
+                Node* node = node_at(index_of(top));
+                // if another producer takes the node first, this may read a stale link,
+                // but then the tag has changed and the exchange fails
+                const uint64_t below = pack(node->next_free.load(std::memory_order_relaxed), tag_of(top) + 1);
+                if (m_free.compare_exchange_weak(top, below, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                    node->next.store(nullptr, std::memory_order_relaxed);
+                    return node;
+                }
+            }
+            if (Node* node = grow()) {
+                return node;
+            }
+        }
+    }
+
+    // adds a chunk of nodes and returns one of them, or nullptr if another
+    // thread added nodes in the meantime
+    Node* grow() {
+        std::lock_guard<std::mutex> guard(m_grow_mutex);
+        if (index_of(m_free.load(std::memory_order_acquire)) != no_index) {
+            return nullptr;
+        }
+        const uint32_t count = m_chunk_count.load(std::memory_order_relaxed);
+        if (count == max_chunks) {
+            return new Node;
+        }
+        Node* chunk = new Node[chunk_size];
+        const uint32_t first = count * chunk_size;
+        for (uint32_t i = 0; i < chunk_size; ++i) {
+            chunk[i].index = first + i;
+            chunk[i].next_free.store(first + i + 1, std::memory_order_relaxed);
+        }
+        m_chunks[count].store(chunk, std::memory_order_release);
+        m_chunk_count.store(count + 1, std::memory_order_relaxed);
+        // the first node is ours, the rest go on the free list in one go
+        push_free(chunk + 1, chunk + chunk_size - 1);
+        return chunk;
+    }
+
+    void release(Node* node) {
+        if (node->index == no_index) {
+            delete node;
+            return;
+        }
+        push_free(node, node);
+    }
+
+    // pushes the chain of nodes from `first` to `last`, linked through next_free
+    void push_free(Node* first, Node* last) {
+        uint64_t top = m_free.load(std::memory_order_relaxed);
+        do {
+            last->next_free.store(index_of(top), std::memory_order_relaxed);
+        } while (!m_free.compare_exchange_weak(top, pack(first->index, tag_of(top) + 1), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // producers push at the head
+    std::atomic<Node*> m_head { nullptr };
+    // the consumer pops after the tail, which is always a dummy node
+    Node* m_tail { nullptr };
+
+    std::atomic<uint64_t> m_free { pack(no_index, 0) };
+    std::atomic<Node*> m_chunks[max_chunks];
+    std::atomic<uint32_t> m_chunk_count { 0 };
+    std::mutex m_grow_mutex;
+};
+
+}
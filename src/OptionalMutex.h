@@ -0,0 +1,36 @@
+#pragma once
+
+#include <mutex>
+
+namespace lk {
+
+// OptionalMutex is a mutex that can be switched off at construction, for state
+// that is only shared between threads in some configurations (see
+// BackendMode::Manual). Disabled, lock() and unlock() do nothing.
+class OptionalMutex {
+public:
+    explicit OptionalMutex(bool enabled = true)
+        : m_enabled(enabled) {
+    }
+    OptionalMutex(const OptionalMutex&) = delete;
+
+    void lock() {
+        if (m_enabled) {
+            m_mutex.lock();
+        }
+    }
+    bool try_lock() {
+        return !m_enabled || m_mutex.try_lock();
+    }
+    void unlock() {
+        if (m_enabled) {
+            m_mutex.unlock();
+        }
+    }
+
+private:
+    const bool m_enabled;
+    std::mutex m_mutex;
+};
+
+}
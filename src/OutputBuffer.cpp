@@ -0,0 +1,158 @@
+#include "OutputBuffer.h"
+#include "impls.h"
+
+#include <algorithm>
+
+namespace {
+const size_t default_max_bytes = 64 * 1024;
+const std::chrono::milliseconds default_max_delay(50);
+
+// the buffer flushed on fatal signals
+std::atomic<lk::OutputBuffer*> s_signal_buffer { nullptr };
+}
+
+lk::OutputBuffer::OutputBuffer(bool threaded)
+    : m_max_bytes(default_max_bytes)
+    , m_max_delay(default_max_delay) {
+    m_staged.reserve(m_max_bytes);
+    m_writing.reserve(m_max_bytes);
+    publish();
+    lk::OutputBuffer* expected = nullptr;
+    if (s_signal_buffer.compare_exchange_strong(expected, this)) {
+        impl::set_fatal_signal_handler(flush_on_signal, false);
+    }
+    if (threaded) {
+        m_thread = std::thread(&lk::OutputBuffer::thread_main, this);
+    }
+}
+
+lk::OutputBuffer::~OutputBuffer() {
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_shutdown = true;
+    }
+    m_cond.notify_one();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    flush();
+    lk::OutputBuffer* expected = this;
+    if (s_signal_buffer.compare_exchange_strong(expected, nullptr)) {
+        impl::set_fatal_signal_handler(nullptr, false);
+    }
+}
+
+void lk::OutputBuffer::set_limits(size_t max_bytes, std::chrono::milliseconds max_delay) {
+    std::unique_lock<std::mutex> guard(m_mutex);
+    m_max_bytes = max_bytes;
+    m_max_delay = max_delay;
+    if (m_staged.size() >= m_max_bytes) {
+        flush(guard);
+        return;
+    }
+    guard.unlock();
+    // the thread may be waiting for the old delay
+    m_cond.notify_one();
+}
+
+void lk::OutputBuffer::set_flush_on_termination_signals(bool enabled) {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (s_signal_buffer.load() == this) {
+        impl::set_fatal_signal_handler(flush_on_signal, enabled);
+    }
+}
+
+bool lk::OutputBuffer::write(const char* data, size_t size) {
+    std::unique_lock<std::mutex> guard(m_mutex);
+    const bool was_empty = m_staged.empty();
+    const size_t new_size = m_staged.size() + size + 1;
+    if (new_size > m_staged.capacity()) {
+        // the signal handler mustn't pick up the old memory once it's freed
+        publish(true);
+        m_staged.reserve(std::max(new_size, m_max_bytes));
+    }
+    m_staged.append(data, size);
+    m_staged += '\n';
+    publish();
+    if (m_staged.size() >= m_max_bytes) {
+        flush(guard);
+        return false;
+    }
+    if (was_empty) {
+        m_first_staged = std::chrono::steady_clock::now();
+        guard.unlock();
+        m_cond.notify_one();
+    }
+    return was_empty;
+}
+
+void lk::OutputBuffer::flush() {
+    std::unique_lock<std::mutex> guard(m_mutex);
+    flush(guard);
+}
+
+void lk::OutputBuffer::flush_if_due() {
+    std::unique_lock<std::mutex> guard(m_mutex);
+    if (!m_staged.empty() && std::chrono::steady_clock::now() >= m_first_staged + m_max_delay) {
+        flush(guard);
+    }
+}
+
+std::chrono::steady_clock::time_point lk::OutputBuffer::next_flush() const {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (m_staged.empty()) {
+        return std::chrono::steady_clock::time_point::max();
+    }
+    return m_first_staged + m_max_delay;
+}
+
+void lk::OutputBuffer::flush(std::unique_lock<std::mutex>& guard) {
+    if (m_staged.empty()) {
+        guard.unlock();
+        return;
+    }
+    std::lock_guard<std::mutex> write_guard(m_write_mutex);
+    m_writing.swap(m_staged);
+    m_staged.clear();
+    publish();
+    guard.unlock();
+    impl::write_output(m_writing.data(), m_writing.size());
+    m_writing.clear();
+}
+
+void lk::OutputBuffer::publish(bool empty) {
+    SignalSnapshot* slot = m_signal_snapshot.load() == &m_signal_slots[0] ? &m_signal_slots[1] : &m_signal_slots[0];
+    slot->data = empty ? nullptr : m_staged.data();
+    slot->size = empty ? 0 : m_staged.size();
+    m_signal_snapshot.store(slot);
+}
+
+void lk::OutputBuffer::thread_main() {
+    std::unique_lock<std::mutex> guard(m_mutex);
+    while (!m_shutdown) {
+        if (m_staged.empty()) {
+            m_cond.wait(guard);
+            continue;
+        }
+        const auto due = m_first_staged + m_max_delay;
+        if (std::chrono::steady_clock::now() >= due) {
+            flush(guard);
+            guard.lock();
+        } else {
+            m_cond.wait_until(guard, due);
+        }
+    }
+}
+
+// runs in a signal handler, so it can only write out what was last published,
+// a line that's being staged at that moment is left out
+void lk::OutputBuffer::flush_on_signal() {
+    lk::OutputBuffer* buffer = s_signal_buffer.load();
+    if (!buffer) {
+        return;
+    }
+    const SignalSnapshot* snapshot = buffer->m_signal_snapshot.load();
+    if (snapshot->data && snapshot->size > 0) {
+        impl::write_output(snapshot->data, snapshot->size);
+    }
+}
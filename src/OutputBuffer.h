@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace lk {
+
+// OutputBuffer collects written lines and writes them to stdout in batches,
+// instead of with a syscall per line: once `max_bytes` are staged, or
+// `max_delay` after the first line was staged, whichever comes first. All
+// writing threads share one buffer, so the order of lines is kept. The write
+// itself happens outside the lock, so other threads can keep staging lines
+// in the meantime.
+// Whatever is staged is written out on flush(), in the destructor, on crash
+// signals, and optionally on termination signals, see
+// impl::set_fatal_signal_handler(). Only the first OutputBuffer alive is
+// flushed on signals.
+class OutputBuffer {
+public:
+    // with `threaded` false, no thread is started, and the owner has to call
+    // flush_if_due() regularly for max_delay to be kept
+    explicit OutputBuffer(bool threaded);
+    OutputBuffer(const OutputBuffer&) = delete;
+    ~OutputBuffer();
+
+    // a max_bytes of 0 writes every line right away
+    void set_limits(size_t max_bytes, std::chrono::milliseconds max_delay);
+    // off by default. does nothing unless this is the buffer flushed on signals.
+    void set_flush_on_termination_signals(bool enabled);
+    // stages `size` bytes from `data` and a newline. returns true if nothing was staged
+    // before, which is when the owner of an unthreaded buffer has a new flush to wait for.
+    bool write(const char* data, size_t size);
+    void flush();
+    void flush_if_due();
+    // when flush_if_due() will flush next, time_point::max() if nothing is staged
+    std::chrono::steady_clock::time_point next_flush() const;
+
+private:
+    void thread_main();
+    // takes `guard` (on m_mutex) and unlocks it
+    void flush(std::unique_lock<std::mutex>& guard);
+    // makes m_staged, or nothing with `empty`, what flush_on_signal() writes
+    void publish(bool empty = false);
+    static void flush_on_signal();
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::string m_staged;
+    // what's being written while m_staged takes new lines
+    std::string m_writing;
+    // held while writing, taken before m_mutex is released, so that batches
+    // are written in the order they were staged
+    std::mutex m_write_mutex;
+    size_t m_max_bytes;
+    std::chrono::milliseconds m_max_delay;
+    std::chrono::steady_clock::time_point m_first_staged;
+    // m_staged as seen by flush_on_signal(), which can't take locks. publish() fills
+    // the slot that isn't current and then switches to it, so a signal never sees
+    // the data of one version with the size of another.
+    struct SignalSnapshot {
+        const char* data { nullptr };
+        size_t size { 0 };
+    };
+    SignalSnapshot m_signal_slots[2];
+    std::atomic<const SignalSnapshot*> m_signal_snapshot { &m_signal_slots[0] };
+    bool m_shutdown { false };
+    std::thread m_thread;
+};
+
+}
@@ -0,0 +1,142 @@
+#include "SuggestionMenu.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+
+namespace {
+// space between two columns
+const size_t cell_padding = 2;
+
+void append_csi(std::string& out, size_t n, char final) {
+    char seq[32];
+    int len = snprintf(seq, sizeof(seq), "\x1b[%zu%c", n, final);
+    out.append(seq, size_t(len));
+}
+
+void move_to_column(std::string& out, size_t column) {
+    // CHA counts from 1
+    append_csi(out, column + 1, 'G');
+}
+}
+
+void lk::SuggestionMenu::set_entries(std::vector<std::string> entries) {
+    m_entries = std::move(entries);
+    m_laid_out = false;
+}
+
+void lk::SuggestionMenu::clear() {
+    m_entries.clear();
+    m_cells.clear();
+    m_laid_out = false;
+}
+
+void lk::SuggestionMenu::cleared() {
+    m_drawn_rows = 0;
+    m_valid = false;
+}
+
+void lk::SuggestionMenu::invalidate() {
+    m_valid = false;
+}
+
+void lk::SuggestionMenu::layout(size_t width, size_t height) {
+    m_width = width;
+    m_height = height;
+    size_t longest = 0;
+    for (const auto& entry : m_entries) {
+        longest = std::max(longest, entry.size());
+    }
+    // the last column stays empty, so that a full row doesn't wrap
+    const size_t usable = width > 1 ? width - 1 : 1;
+    m_cell_width = std::min(longest + cell_padding, usable);
+    m_columns = std::max<size_t>(1, usable / m_cell_width);
+    m_rows = (m_entries.size() + m_columns - 1) / m_columns;
+    // at most a third of the screen, the rest scrolls
+    m_visible_rows = std::min(m_rows, std::max<size_t>(1, height / 3));
+    m_cells.clear();
+    m_cells.reserve(m_entries.size() * m_cell_width);
+    for (const auto& entry : m_entries) {
+        // entries that don't fit are cut, but still leave a space to the next one
+        const size_t size = std::min(entry.size(), m_cell_width - 1);
+        m_cells.append(entry, 0, size);
+        m_cells.append(m_cell_width - size, ' ');
+    }
+    m_laid_out = true;
+    m_valid = false;
+}
+
+void lk::SuggestionMenu::append_cell(std::string& out, size_t index, bool selected) const {
+    if (selected) {
+        out += "\x1b[7m";
+    }
+    out.append(m_cells, index * m_cell_width, m_cell_width);
+    if (selected) {
+        out += "\x1b[0m";
+    }
+}
+
+void lk::SuggestionMenu::append_row(std::string& out, size_t row, size_t selected) const {
+    const size_t begin = row * m_columns;
+    const size_t end = std::min(begin + m_columns, m_entries.size());
+    if (selected >= begin && selected < end) {
+        out.append(m_cells, begin * m_cell_width, (selected - begin) * m_cell_width);
+        append_cell(out, selected, true);
+        out.append(m_cells, (selected + 1) * m_cell_width, (end - selected - 1) * m_cell_width);
+    } else {
+        out.append(m_cells, begin * m_cell_width, (end - begin) * m_cell_width);
+    }
+    out += "\x1b[K";
+}
+
+void lk::SuggestionMenu::render(size_t selected, size_t cursor_column, size_t width, size_t height, std::string& out) {
+    if (m_entries.empty()) {
+        if (m_drawn_rows > 0) {
+            out += "\x1b[B\r\x1b[J\x1b[A";
+            move_to_column(out, cursor_column);
+            m_drawn_rows = 0;
+        }
+        return;
+    }
+    if (!m_laid_out || width != m_width || height != m_height) {
+        layout(width, height);
+    }
+    selected = std::min(selected, m_entries.size() - 1);
+    // scroll just far enough to show the selected row
+    const size_t row = selected / m_columns;
+    size_t top = m_valid ? m_drawn_top : 0;
+    if (row < top) {
+        top = row;
+    } else if (row >= top + m_visible_rows) {
+        top = row + 1 - m_visible_rows;
+    }
+    top = std::min(top, m_rows - m_visible_rows);
+    if (!m_valid || top != m_drawn_top || m_drawn_rows != m_visible_rows) {
+        // on the first draw, the newlines scroll the screen up to make room
+        for (size_t i = 0; i < m_visible_rows; ++i) {
+            out += "\r\n";
+            append_row(out, top + i, selected);
+        }
+        if (m_drawn_rows > m_visible_rows) {
+            out += "\x1b[J";
+        }
+        append_csi(out, m_visible_rows, 'A');
+        m_drawn_rows = m_visible_rows;
+        m_drawn_top = top;
+        m_valid = true;
+    } else if (selected != m_drawn_selected) {
+        // only the cells that were and are now selected change
+        const size_t cells[] = { m_drawn_selected, selected };
+        for (size_t cell : cells) {
+            const size_t down = cell / m_columns - top + 1;
+            append_csi(out, down, 'B');
+            move_to_column(out, (cell % m_columns) * m_cell_width);
+            append_cell(out, cell, cell == selected);
+            append_csi(out, down, 'A');
+        }
+    } else {
+        return;
+    }
+    move_to_column(out, cursor_column);
+    m_drawn_selected = selected;
+}
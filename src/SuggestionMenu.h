@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace lk {
+
+// SuggestionMenu draws completion suggestions in columns on the lines below the
+// prompt, with the selected one highlighted, and puts the cursor back where it
+// was on the prompt line. The entries are laid out once into fixed-width cells
+// (again only when the terminal size changes), and moving the selection within
+// the visible rows only redraws the two cells that changed. Lists longer than
+// the visible rows scroll with the selection.
+// Like LineRenderer, it assumes one byte is one column.
+class SuggestionMenu {
+public:
+    void set_entries(std::vector<std::string> entries);
+    // removes the menu, the next render() erases it from the screen
+    void clear();
+    size_t size() const { return m_entries.size(); }
+    // valid after the first render()
+    size_t columns() const { return m_columns; }
+
+    // appends what's needed to show the menu with `selected` highlighted, starting
+    // from and returning to `cursor_column` on the prompt line
+    void render(size_t selected, size_t cursor_column, size_t width, size_t height, std::string& out);
+    // the lines below the prompt were erased, e.g. by output written over them
+    void cleared();
+    // the state of the screen is unknown (e.g. after a resize), so the next render redraws it in full
+    void invalidate();
+
+private:
+    void layout(size_t width, size_t height);
+    void append_cell(std::string& out, size_t index, bool selected) const;
+    void append_row(std::string& out, size_t row, size_t selected) const;
+
+    std::vector<std::string> m_entries;
+    // the layout, see layout()
+    bool m_laid_out { false };
+    size_t m_width { 0 };
+    size_t m_height { 0 };
+    size_t m_cell_width { 0 };
+    size_t m_columns { 1 };
+    size_t m_rows { 0 };
+    size_t m_visible_rows { 0 };
+    // every entry padded or cut to m_cell_width, row after row
+    std::string m_cells;
+    // what's on the screen right now
+    size_t m_drawn_rows { 0 };
+    size_t m_drawn_top { 0 };
+    size_t m_drawn_selected { 0 };
+    bool m_valid { false };
+};
+
+}
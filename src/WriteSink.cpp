@@ -0,0 +1,124 @@
+#include "WriteSink.h"
+
+lk::AsyncSink::AsyncSink(Callback callback, size_t max_lines, size_t max_bytes, OverflowPolicy policy)
+    : m_callback(std::move(callback))
+    , m_max_lines(max_lines)
+    , m_max_bytes(max_bytes)
+    , m_policy(policy) {
+    m_thread = std::thread(&lk::AsyncSink::thread_main, this);
+}
+
+lk::AsyncSink::~AsyncSink() {
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_shutdown = true;
+    }
+    m_cond.notify_one();
+    m_space_cond.notify_all();
+    m_thread.join();
+}
+
+void lk::AsyncSink::push(const std::string& line) {
+    std::unique_lock<std::mutex> guard(m_mutex);
+    push_locked(guard, line);
+    guard.unlock();
+    m_cond.notify_one();
+}
+
+void lk::AsyncSink::push(const std::vector<std::string>& lines) {
+    std::unique_lock<std::mutex> guard(m_mutex);
+    for (const auto& line : lines) {
+        push_locked(guard, line);
+    }
+    guard.unlock();
+    m_cond.notify_one();
+}
+
+size_t lk::AsyncSink::dropped_lines() const {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_dropped_lines;
+}
+
+bool lk::AsyncSink::over_limit(size_t extra_bytes) const {
+    const size_t lines = m_queue.size() - m_queue_begin;
+    // a line is always accepted into an empty queue
+    if (lines == 0) {
+        return false;
+    }
+    return (m_max_lines != 0 && lines + 1 > m_max_lines)
+        || (m_max_bytes != 0 && m_queue_bytes + extra_bytes > m_max_bytes);
+}
+
+void lk::AsyncSink::push_locked(std::unique_lock<std::mutex>& guard, const std::string& line) {
+    if (over_limit(line.size())) {
+        switch (m_policy) {
+        case OverflowPolicy::Block:
+            m_cond.notify_one();
+            m_space_cond.wait(guard, [&] { return m_shutdown || !over_limit(line.size()); });
+            break;
+        case OverflowPolicy::DropNewest:
+            ++m_dropped_lines;
+            return;
+        case OverflowPolicy::DropOldest:
+        case OverflowPolicy::Collapse:
+            while (over_limit(line.size())) {
+                std::string& oldest = m_queue[m_queue_begin++];
+                m_queue_bytes -= oldest.size();
+                std::string().swap(oldest);
+                ++m_dropped_lines;
+            }
+            break;
+        }
+    }
+    m_queue.push_back(line);
+    m_queue_bytes += line.size();
+}
+
+void lk::AsyncSink::thread_main() {
+    std::vector<std::string> batch;
+    bool shutdown = false;
+    while (!shutdown) {
+        {
+            std::unique_lock<std::mutex> guard(m_mutex);
+            m_cond.wait(guard, [&] { return m_queue.size() > m_queue_begin || m_shutdown; });
+            shutdown = m_shutdown;
+            m_queue.erase(m_queue.begin(), m_queue.begin() + std::ptrdiff_t(m_queue_begin));
+            m_queue_begin = 0;
+            m_queue_bytes = 0;
+            batch.swap(m_queue);
+            if (m_policy == OverflowPolicy::Collapse && m_dropped_lines != m_reported_dropped_lines) {
+                batch.insert(batch.begin(), "[" + std::to_string(m_dropped_lines - m_reported_dropped_lines) + " lines dropped]");
+                m_reported_dropped_lines = m_dropped_lines;
+            }
+        }
+        m_space_cond.notify_all();
+        if (!batch.empty() && m_callback) {
+            m_callback(batch);
+        }
+        batch.clear();
+    }
+}
+
+lk::FileSink::FileSink(const std::string& path, bool append)
+    : m_file(std::fopen(path.c_str(), append ? "a" : "w"), [](std::FILE* file) {
+        if (file) {
+            std::fclose(file);
+        }
+    }) {
+    if (m_file) {
+        std::setvbuf(m_file.get(), nullptr, _IOFBF, 64 * 1024);
+    } else {
+        m_file.reset();
+    }
+}
+
+void lk::FileSink::operator()(const std::vector<std::string>& lines) {
+    if (!m_file) {
+        return;
+    }
+    for (const auto& line : lines) {
+        std::fwrite(line.data(), 1, line.size(), m_file.get());
+        std::fputc('\n', m_file.get());
+    }
+    std::fflush(m_file.get());
+}
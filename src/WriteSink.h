@@ -0,0 +1,70 @@
+#pragma once
+
+#include "backends/Backend.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace lk {
+
+// AsyncSink delivers written lines to a callback on its own thread, in batches,
+// so that a slow consumer (a log file on a slow disk, fsync, network) never holds
+// up the terminal. It has its own queue limit, independent of the terminal's.
+// Everything that was pushed is delivered before the destructor returns.
+class AsyncSink {
+public:
+    using Callback = std::function<void(const std::vector<std::string>&)>;
+
+    // limits of 0 mean unlimited
+    explicit AsyncSink(Callback callback, size_t max_lines = 0, size_t max_bytes = 0, OverflowPolicy policy = OverflowPolicy::Block);
+    AsyncSink(const AsyncSink&) = delete;
+    ~AsyncSink();
+
+    void push(const std::string& line);
+    void push(const std::vector<std::string>& lines);
+    size_t dropped_lines() const;
+
+private:
+    void thread_main();
+    bool over_limit(size_t extra_bytes) const;
+    void push_locked(std::unique_lock<std::mutex>& guard, const std::string& line);
+
+    Callback m_callback;
+    const size_t m_max_lines;
+    const size_t m_max_bytes;
+    const OverflowPolicy m_policy;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::condition_variable m_space_cond;
+    // m_queue[m_queue_begin..] are pending, lines before that were dropped
+    std::vector<std::string> m_queue;
+    size_t m_queue_begin { 0 };
+    size_t m_queue_bytes { 0 };
+    size_t m_dropped_lines { 0 };
+    size_t m_reported_dropped_lines { 0 };
+    bool m_shutdown { false };
+    std::thread m_thread;
+};
+
+// FileSink writes each batch of lines to a file through a large stdio buffer,
+// and flushes once per batch. Meant to be used as an AsyncSink callback.
+class FileSink {
+public:
+    explicit FileSink(const std::string& path, bool append = false);
+
+    bool is_open() const { return m_file != nullptr; }
+    void operator()(const std::vector<std::string>& lines);
+
+private:
+    // shared, as std::function needs its target to be copyable
+    std::shared_ptr<std::FILE> m_file;
+};
+
+}
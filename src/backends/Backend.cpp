@@ -1 +1,33 @@
 #include "Backend.h"
+
+#include "WriteSink.h"
+
+lk::Backend::Backend() = default;
+lk::Backend::~Backend() = default;
+
+void lk::Backend::add_sink(std::unique_ptr<AsyncSink> sink) {
+    std::lock_guard<std::mutex> guard(m_sinks_mutex);
+    m_sinks.push_back(std::move(sink));
+}
+
+void lk::Backend::dispatch_write(const std::string& line) {
+    if (on_write) {
+        on_write(line);
+    }
+    std::lock_guard<std::mutex> guard(m_sinks_mutex);
+    for (auto& sink : m_sinks) {
+        sink->push(line);
+    }
+}
+
+void lk::Backend::dispatch_write(const std::vector<std::string>& lines) {
+    if (on_write) {
+        for (const auto& line : lines) {
+            on_write(line);
+        }
+    }
+    std::lock_guard<std::mutex> guard(m_sinks_mutex);
+    for (auto& sink : m_sinks) {
+        sink->push(lines);
+    }
+}
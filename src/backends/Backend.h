@@ -1,30 +1,133 @@
 #pragma once
 
+#include "AutocompleteRequest.h"
+#include <chrono>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 namespace lk {
 
+class AsyncSink;
+
+// how a backend gets its work done
+enum class BackendMode {
+    // input and output are handled on internal threads (default)
+    Threaded,
+    // no internal threads, the owner drives input and output by calling
+    // poll_once() or process_input() regularly on one thread
+    Manual,
+};
+
+// what write() does when the output queue is over its limit
+enum class OverflowPolicy {
+    // wait until enough queued output has been written out
+    Block,
+    // discard the line being written
+    DropNewest,
+    // discard the oldest queued lines
+    DropOldest,
+    // discard the oldest queued lines and output a "[N lines dropped]" line instead
+    Collapse,
+};
+
+// a command in memory owned by the backend, see get_command_views()
+struct CommandView {
+    CommandView() = default;
+    CommandView(const char* data, size_t size)
+        : data(data)
+        , size(size) { }
+
+    const char* data { nullptr };
+    size_t size { 0 };
+
+    std::string str() const { return std::string(data, size); }
+};
+
 class Backend {
 public:
-    Backend() = default;
+    Backend();
     Backend(const Backend&) = delete;
-    virtual ~Backend() = default;
+    virtual ~Backend();
 
     virtual bool has_command() const = 0;
     virtual void write(const std::string& str) = 0;
+    // like write(const std::string&), but may take over the string's buffer instead of copying it
+    virtual void write(std::string&& str) = 0;
+    virtual void write(const char* data, size_t size) = 0;
     virtual std::string get_command() = 0;
+    // takes all pending commands at once
+    virtual std::vector<std::string> get_commands() = 0;
+    // takes up to `max` pending commands, appending views of them to `views`, and returns
+    // how many it took. the views stay valid until the next call. reusing `views`
+    // across calls avoids allocating per command where the backend can (ScriptBackend).
+    virtual size_t get_command_views(std::vector<CommandView>& views, size_t max) = 0;
+    // blocks until a command is available. returns false if none will ever arrive,
+    // because the input was closed.
+    virtual bool wait_for_command() = 0;
+    // like wait_for_command(), but also returns false once the timeout expires
+    virtual bool wait_for_command(std::chrono::milliseconds timeout) = 0;
+    // a file descriptor that is readable while commands are pending, for use with
+    // poll/epoll/select. reading commands makes it unreadable again once none are left.
+    // -1 if not supported (windows).
+    virtual int command_fd() const = 0;
+    // BackendMode::Manual only: waits up to `timeout` for input, or for output written by
+    // other threads, handles it, and writes out pending output. returns true if any
+    // input was handled. once the input is closed, it only waits for output.
+    virtual bool poll_once(std::chrono::milliseconds timeout) = 0;
+    // BackendMode::Manual only: handles input the owner read from stdin itself, and
+    // writes out pending output
+    virtual void process_input(const char* data, size_t size) = 0;
     virtual bool history_enabled() const = 0;
     virtual void enable_history() = 0;
     virtual void disable_history() = 0;
     virtual void set_history_limit(size_t count) = 0;
+    // limits the total length of all history entries, 0 means unlimited (default)
+    virtual void set_history_byte_limit(size_t bytes) = 0;
+    // if enabled, a command equal to the previous one isn't added to the history again
+    virtual void set_history_ignore_duplicates(bool ignore) = 0;
     virtual size_t history_size() const = 0;
     virtual void clear_history() = 0;
-    virtual const std::vector<std::string>& history() const = 0;
+    // loads the history from `path`, and appends every new entry to it from now on.
+    // the file is compacted once it grows well past the history limits.
+    virtual bool set_history_file(const std::string& path) = 0;
+    // a copy of the history, oldest first
+    virtual std::vector<std::string> history() const = 0;
     virtual void set_history(const std::vector<std::string>& history) = 0;
     virtual void set_prompt(const std::string& p) = 0;
     virtual std::string prompt() const = 0;
+    // how long to wait for the rest of an escape sequence before treating ESC as a keypress
+    virtual void set_escape_timeout(std::chrono::milliseconds timeout) = 0;
+    // limits how much output may be queued but not yet written, 0 means unlimited (default)
+    virtual void set_write_limit(size_t max_lines, size_t max_bytes, OverflowPolicy policy) = 0;
+    // how many lines were discarded because of the write limit
+    virtual size_t dropped_lines() const = 0;
+    // caps how often the screen is updated with written lines, 0 means unlimited (default).
+    // lines written within one frame are printed together, with one prompt redraw.
+    // on_write and sinks still get every line as soon as it's written.
+    virtual void set_render_rate(unsigned frames_per_second) = 0;
+    // when not on a terminal (piped, redirected, scripts), written lines are written out in
+    // batches of up to `max_bytes`, at most `max_delay` after they were written. a max_bytes
+    // of 0 writes every line right away. defaults to 64 KiB and 50 ms.
+    virtual void set_output_buffering(size_t max_bytes, std::chrono::milliseconds max_delay) = 0;
+    // also writes out held back output when the process is ended by SIGTERM, SIGINT, SIGHUP or
+    // SIGQUIT. off by default, since it installs process-wide signal handlers. signals the
+    // program handles or ignores itself are left alone. only the first Commandline's output
+    // is written on signals.
+    virtual void set_flush_on_termination_signals(bool enabled) = 0;
+    // writes out all output that's held back, see set_output_buffering() and set_render_rate()
+    virtual void flush() = 0;
+    // registers a line of space-separated words for tab completion, e.g. "config reload".
+    // registered completions are tried before on_autocomplete_async.
+    virtual void add_completion(const std::string& line) = 0;
+    // like add_completion() for each line, but cheaper for many lines
+    virtual void add_completions(const std::vector<std::string>& lines) = 0;
+    virtual void clear_completions() = 0;
+    // matches registered completions fuzzily (like fzf) instead of by prefix, best match first
+    virtual void enable_fuzzy_completion() = 0;
+    virtual void disable_fuzzy_completion() = 0;
 
     // key_debug writes escape-sequenced keys to stderr
     virtual void enable_key_debug() = 0;
@@ -33,11 +136,26 @@ public:
     // gets called when a command is ready
     std::function<void(Backend&)> on_command { nullptr };
 
-    // gets called when tab is pressed and new suggestions are requested
-    std::function<std::vector<std::string>(Backend&, std::string, int)> on_autocomplete { nullptr };
+    // gets called when tab is pressed and new suggestions are requested. they are
+    // delivered later through the request, so a slow lookup doesn't hold up typing.
+    // the callback itself should return quickly.
+    std::function<void(Backend&, AutocompleteRequest)> on_autocomplete_async { nullptr };
 
     // gets called on write(), for writing to a file or similar secondary logging system
     std::function<void(const std::string&)> on_write { nullptr };
+
+    // like on_write, but the sink gets the lines in batches on its own thread.
+    // sinks are flushed and destroyed with the backend.
+    void add_sink(std::unique_ptr<AsyncSink> sink);
+
+protected:
+    // hands written lines to on_write and all sinks
+    void dispatch_write(const std::string& line);
+    void dispatch_write(const std::vector<std::string>& lines);
+
+private:
+    std::mutex m_sinks_mutex;
+    std::vector<std::unique_ptr<AsyncSink>> m_sinks;
 };
 
 }
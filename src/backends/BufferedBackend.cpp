@@ -1,84 +1,224 @@
 #include "BufferedBackend.h"
-#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <iterator>
 
 bool lk::BufferedBackend::has_command() const {
     std::lock_guard<std::mutex> lock(m_cmd_mtx);
     return !m_input_queue.empty();
 }
-void lk::BufferedBackend::write(const std::string& str) {
-    std::lock_guard<std::mutex> lock(m_out_mtx);
-    std::cout << str << std::endl;
-    if (on_write) {
-        on_write(str);
-    }
-}
 std::string lk::BufferedBackend::get_command() {
     std::lock_guard<std::mutex> lock(m_cmd_mtx);
     auto cmd = std::move(m_input_queue.front());
     m_input_queue.pop_front();
+    if (m_input_queue.empty()) {
+        impl::drain_wakeup_pipe(m_command_pipe);
+    }
     return cmd;
 }
-bool lk::BufferedBackend::history_enabled() const {
-    return false;
-}
-void lk::BufferedBackend::enable_history() {
-}
-void lk::BufferedBackend::disable_history() {
-}
-void lk::BufferedBackend::set_history_limit(size_t) {
-}
-size_t lk::BufferedBackend::history_size() const {
-    return 0;
-}
-void lk::BufferedBackend::clear_history() {
-}
-const std::vector<std::string>& lk::BufferedBackend::history() const {
-    static const std::vector<std::string> empty_vec {};
-    return empty_vec;
-}
-void lk::BufferedBackend::set_history(const std::vector<std::string>&) {
-}
-
-void lk::BufferedBackend::set_prompt(const std::string& p) {
-    std::lock_guard<std::mutex> lock(m_prompt_mtx);
-    m_prompt = p;
-}
-
-std::string lk::BufferedBackend::prompt() const {
-    std::lock_guard<std::mutex> lock(m_prompt_mtx);
-    return m_prompt;
-}
-void lk::BufferedBackend::enable_key_debug() {
+std::vector<std::string> lk::BufferedBackend::get_commands() {
+    std::lock_guard<std::mutex> lock(m_cmd_mtx);
+    std::vector<std::string> cmds(std::make_move_iterator(m_input_queue.begin()), std::make_move_iterator(m_input_queue.end()));
+    m_input_queue.clear();
+    impl::drain_wakeup_pipe(m_command_pipe);
+    return cmds;
 }
-void lk::BufferedBackend::disable_key_debug() {
+size_t lk::BufferedBackend::get_command_views(std::vector<CommandView>& views, size_t max) {
+    {
+        std::lock_guard<std::mutex> lock(m_cmd_mtx);
+        const size_t count = std::min(max, m_input_queue.size());
+        m_view_commands.assign(std::make_move_iterator(m_input_queue.begin()), std::make_move_iterator(m_input_queue.begin() + std::ptrdiff_t(count)));
+        m_input_queue.erase(m_input_queue.begin(), m_input_queue.begin() + std::ptrdiff_t(count));
+        if (m_input_queue.empty()) {
+            impl::drain_wakeup_pipe(m_command_pipe);
+        }
+    }
+    for (const auto& command : m_view_commands) {
+        views.emplace_back(command.data(), command.size());
+    }
+    return m_view_commands.size();
+}
+bool lk::BufferedBackend::wait_for_command() {
+    return wait_until(std::chrono::steady_clock::time_point::max());
+}
+bool lk::BufferedBackend::wait_for_command(std::chrono::milliseconds timeout) {
+    return wait_until(std::chrono::steady_clock::now() + timeout);
+}
+// time_point::max() waits for as long as it takes
+bool lk::BufferedBackend::wait_until(std::chrono::steady_clock::time_point deadline) {
+    const bool forever = deadline == std::chrono::steady_clock::time_point::max();
+    if (!m_threaded) {
+        // nobody else is going to read input, so drive it from here
+        auto now = std::chrono::steady_clock::now();
+        while (!has_command() && !m_stdin_closed && now < deadline) {
+            poll_once(forever ? std::chrono::milliseconds(-1) : std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now));
+            now = std::chrono::steady_clock::now();
+        }
+        return has_command();
+    }
+    std::unique_lock<std::mutex> lock(m_cmd_mtx);
+    const auto ready = [&] { return !m_input_queue.empty() || m_input_closed; };
+    if (forever) {
+        m_cmd_cond.wait(lock, ready);
+    } else {
+        m_cmd_cond.wait_until(lock, deadline, ready);
+    }
+    return !m_input_queue.empty();
 }
-lk::BufferedBackend::BufferedBackend(const std::string& prompt) {
-    std::lock_guard<std::mutex> lock(m_prompt_mtx);
-    m_prompt = prompt;
-    m_thread = std::thread([this] { thread_main(); });
+lk::BufferedBackend::BufferedBackend(const std::string& prompt, BackendMode mode)
+    : NonInteractiveBackend(prompt, mode == BackendMode::Threaded)
+    , m_threaded(mode == BackendMode::Threaded) {
+    impl::open_wakeup_pipe(m_command_pipe);
+    impl::open_wakeup_pipe(m_wakeup_pipe);
+    if (m_threaded) {
+        m_thread = std::thread([this] { thread_main(); });
+    }
 }
 lk::BufferedBackend::~BufferedBackend() {
-    {
-        std::lock_guard<std::mutex> lock(m_shutdown_mtx);
-        m_shutdown = true;
+    m_shutdown.store(true);
+    impl::signal_wakeup_pipe(m_wakeup_pipe);
+    if (m_thread.joinable()) {
+        m_thread.join();
     }
-    m_thread.join();
+    impl::close_wakeup_pipe(m_wakeup_pipe);
+    impl::close_wakeup_pipe(m_command_pipe);
 }
 void lk::BufferedBackend::thread_main() {
-    std::string str;
-    while (std::getline(std::cin, str)) {
-        {
-            std::lock_guard<std::mutex> lock(m_shutdown_mtx);
-            if (m_shutdown) {
-                break;
-            }
+    // the destructor wakes us through m_wakeup_pipe. without one (windows),
+    // look for the shutdown every so often
+    const int timeout_ms = m_wakeup_pipe.read_fd == -1 ? impl::wakeup_poll_interval_ms : -1;
+    while (!m_shutdown.load()) {
+        bool woken = false;
+        if (!impl::wait_for_stdin(timeout_ms, m_wakeup_pipe, woken)) {
+            continue;
+        }
+        int n = impl::read_stdin(m_input_buffer, sizeof(m_input_buffer));
+        if (n <= 0) {
+            finish_input();
+            return;
+        }
+        split_lines(m_input_buffer, size_t(n));
+    }
+    close_input();
+}
+// pushes every complete line in `data` at once, and keeps the rest for the next call
+void lk::BufferedBackend::split_lines(const char* data, size_t size) {
+    const char* end = data + size;
+    while (data < end) {
+        const char* newline = static_cast<const char*>(std::memchr(data, '\n', size_t(end - data)));
+        if (!newline) {
+            m_partial_line.append(data, end);
+            break;
         }
-        {
-            std::lock_guard<std::mutex> lock(m_cmd_mtx);
-            m_input_queue.push_back(str);
+        if (m_partial_line.empty()) {
+            m_lines.emplace_back(data, newline);
+        } else {
+            m_partial_line.append(data, newline);
+            m_lines.push_back(std::move(m_partial_line));
+            m_partial_line.clear();
         }
-        if (on_command) {
+        data = newline + 1;
+    }
+    push_commands(m_lines);
+}
+// stdin is closed. like std::getline, a last line without a newline still counts.
+void lk::BufferedBackend::finish_input() {
+    m_stdin_closed = true;
+    if (!m_partial_line.empty()) {
+        push_command(m_partial_line);
+        m_partial_line.clear();
+    }
+    close_input();
+}
+void lk::BufferedBackend::push_command(const std::string& str) {
+    {
+        std::lock_guard<std::mutex> lock(m_cmd_mtx);
+        if (m_input_queue.empty()) {
+            impl::signal_wakeup_pipe(m_command_pipe);
+        }
+        m_input_queue.push_back(str);
+    }
+    m_cmd_cond.notify_all();
+    if (on_command) {
+        on_command(*this);
+    }
+}
+void lk::BufferedBackend::push_commands(std::vector<std::string>& commands) {
+    if (commands.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_cmd_mtx);
+        if (m_input_queue.empty()) {
+            impl::signal_wakeup_pipe(m_command_pipe);
+        }
+        m_input_queue.insert(m_input_queue.end(), std::make_move_iterator(commands.begin()), std::make_move_iterator(commands.end()));
+    }
+    m_cmd_cond.notify_all();
+    if (on_command) {
+        for (size_t i = 0; i < commands.size(); ++i) {
             on_command(*this);
         }
     }
+    commands.clear();
+}
+void lk::BufferedBackend::close_input() {
+    {
+        std::lock_guard<std::mutex> lock(m_cmd_mtx);
+        m_input_closed = true;
+    }
+    m_cmd_cond.notify_all();
+}
+void lk::BufferedBackend::on_output_staged() {
+    if (!m_threaded) {
+        impl::signal_wakeup_pipe(m_wakeup_pipe);
+    }
+}
+bool lk::BufferedBackend::poll_once(std::chrono::milliseconds timeout) {
+    if (m_threaded) {
+        return false;
+    }
+    // nobody else is going to flush held back output in time
+    m_output.flush_if_due();
+    const auto next_flush = m_output.next_flush();
+    if (next_flush != std::chrono::steady_clock::time_point::max()) {
+        const auto until_flush = std::chrono::duration_cast<std::chrono::milliseconds>(next_flush - std::chrono::steady_clock::now()) + std::chrono::milliseconds(1);
+        if (timeout.count() < 0 || until_flush < timeout) {
+            timeout = until_flush;
+        }
+    }
+    if (m_wakeup_pipe.read_fd == -1 && (timeout.count() < 0 || timeout.count() > impl::wakeup_poll_interval_ms)) {
+        // without a wakeup pipe (windows), lines staged by other threads can't wake us up,
+        // so look for them every so often
+        timeout = std::chrono::milliseconds(impl::wakeup_poll_interval_ms);
+    }
+    bool woken = false;
+    bool ready = false;
+    if (m_stdin_closed) {
+        // nothing to read anymore, but staged output still wakes us up
+        woken = impl::wait_for_wakeup_pipe(int(timeout.count()), m_wakeup_pipe);
+    } else {
+        ready = impl::wait_for_stdin(int(timeout.count()), m_wakeup_pipe, woken);
+    }
+    if (woken) {
+        // another thread staged output, the next call waits until it's due instead
+        impl::drain_wakeup_pipe(m_wakeup_pipe);
+    }
+    if (!ready) {
+        return false;
+    }
+    int n = impl::read_stdin(m_input_buffer, sizeof(m_input_buffer));
+    if (n <= 0) {
+        finish_input();
+        return false;
+    }
+    process_input(m_input_buffer, size_t(n));
+    return true;
+}
+void lk::BufferedBackend::process_input(const char* data, size_t size) {
+    if (m_threaded) {
+        return;
+    }
+    split_lines(data, size);
+    m_output.flush_if_due();
 }
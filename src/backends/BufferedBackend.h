@@ -1,44 +1,63 @@
 #pragma once
 
-#include "Backend.h"
+#include "NonInteractiveBackend.h"
+#include "impls.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <deque>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 namespace lk {
 
-class BufferedBackend : public Backend {
+class BufferedBackend : public NonInteractiveBackend {
 public:
-    explicit BufferedBackend(const std::string& prompt);
+    explicit BufferedBackend(const std::string& prompt, BackendMode mode = BackendMode::Threaded);
     ~BufferedBackend() override;
 
     bool has_command() const override;
-    void write(const std::string& str) override;
     std::string get_command() override;
-    bool history_enabled() const override;
-    void enable_history() override;
-    void disable_history() override;
-    void set_history_limit(size_t count) override;
-    size_t history_size() const override;
-    void clear_history() override;
-    const std::vector<std::string>& history() const override;
-    void set_history(const std::vector<std::string>& history) override;
-    void set_prompt(const std::string& p) override;
-    std::string prompt() const override;
-    void enable_key_debug() override;
-    void disable_key_debug() override;
+    std::vector<std::string> get_commands() override;
+    size_t get_command_views(std::vector<CommandView>& views, size_t max) override;
+    bool wait_for_command() override;
+    bool wait_for_command(std::chrono::milliseconds timeout) override;
+    int command_fd() const override { return m_command_pipe.read_fd; }
+    bool poll_once(std::chrono::milliseconds timeout) override;
+    void process_input(const char* data, size_t size) override;
 
 private:
+    void on_output_staged() override;
+    bool wait_until(std::chrono::steady_clock::time_point deadline);
     void thread_main();
+    void push_command(const std::string& str);
+    void push_commands(std::vector<std::string>& commands);
+    void split_lines(const char* data, size_t size);
+    void finish_input();
+    void close_input();
+
+    const bool m_threaded;
+    // the unfinished last line of input
+    std::string m_partial_line;
+    // lines split off the input, pushed in one go, see split_lines()
+    std::vector<std::string> m_lines;
+    bool m_stdin_closed = false;
+    // large, so that piped input takes few reads
+    char m_input_buffer[65536];
 
     mutable std::mutex m_cmd_mtx {};
-    mutable std::mutex m_out_mtx {};
-    mutable std::mutex m_prompt_mtx {};
-    mutable std::mutex m_shutdown_mtx {};
-    bool m_shutdown = false;
+    std::condition_variable m_cmd_cond {};
+    bool m_input_closed = false;
+    std::atomic<bool> m_shutdown { false };
+    // wakes the thread up from waiting for input on shutdown, or in manual mode
+    // poll_once() when output is staged
+    impl::WakeupPipe m_wakeup_pipe {};
     std::deque<std::string> m_input_queue {};
-    std::string m_prompt;
+    // what the last get_command_views() points into
+    std::vector<std::string> m_view_commands {};
+    // signaled while m_input_queue is non-empty
+    impl::WakeupPipe m_command_pipe {};
     std::thread m_thread;
 };
 
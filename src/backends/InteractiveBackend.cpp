@@ -2,18 +2,79 @@
 
 #include "impls.h"
 
-lk::InteractiveBackend::InteractiveBackend(const std::string& prompt)
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+
+namespace {
+// set on the io thread, so that write() calls made from on_write never block on the
+// io thread itself
+thread_local const lk::InteractiveBackend* t_io_thread_backend = nullptr;
+// more fuzzy matches than this aren't worth cycling through
+const size_t max_fuzzy_matches = 100;
+// see recycle_line()
+const size_t max_spare_lines = 1024;
+const size_t max_spare_line_capacity = 4096;
+}
+
+lk::InteractiveBackend::InteractiveBackend(const std::string& prompt, BackendMode mode)
     : Backend()
-    , m_prompt(prompt) {
+    , m_prompt(prompt)
+    , m_threaded(mode == BackendMode::Threaded)
+#if defined(WINDOWS)
+    , m_key_decoder(true)
+#endif
+    , m_history_mutex(m_threaded)
+    , m_current_buffer_mutex(m_threaded)
+    , m_completions_mutex(m_threaded) {
     impl::init_terminal();
-    m_io_thread = std::thread(&lk::InteractiveBackend::io_thread_main, this);
+    impl::open_wakeup_pipe(m_command_pipe);
+    impl::open_wakeup_pipe(m_wakeup_pipe);
+    impl::watch_terminal_resize(m_wakeup_pipe);
+    m_terminal_size = impl::get_terminal_size();
+    m_autocomplete_mailbox = std::make_shared<AutocompleteMailbox>();
+    m_autocomplete_mailbox->notify = [this] {
+        impl::signal_wakeup_pipe(m_wakeup_pipe);
+    };
+    if (m_threaded) {
+        m_io_thread = std::thread(&lk::InteractiveBackend::io_thread_main, this);
+        m_input_thread = std::thread(&lk::InteractiveBackend::input_thread_main, this);
+    } else {
+        // the owner's thread does the io thread's job
+        t_io_thread_backend = this;
+        update_current_buffer_view();
+    }
 }
 
 lk::InteractiveBackend::~InteractiveBackend() {
     m_shutdown.store(true);
-    m_to_write_cond.notify_one();
-    m_io_thread.join();
+    close_input();
+    if (m_threaded) {
+        impl::signal_wakeup_pipe(m_wakeup_pipe);
+        {
+            std::lock_guard<std::mutex> guard(m_space_mutex);
+        }
+        m_space_cond.notify_all();
+        // the input thread may still write (from on_command), so the io thread
+        // goes last and writes out everything that's left
+        m_input_thread.join();
+        wake_io_thread();
+        m_io_thread.join();
+    } else {
+        flush_output(true);
+    }
+    impl::unwatch_terminal_resize();
+    {
+        // requests may still be completed after we're gone
+        std::lock_guard<std::mutex> guard(m_autocomplete_mailbox->mutex);
+        m_autocomplete_mailbox->notify = nullptr;
+    }
+    cancel_autocomplete_request();
     impl::reset_terminal();
+    impl::close_wakeup_pipe(m_command_pipe);
+    impl::close_wakeup_pipe(m_wakeup_pipe);
+    impl::close_file(m_history_fd);
 }
 
 void lk::InteractiveBackend::set_prompt(const std::string& p) {
@@ -32,31 +93,39 @@ void lk::InteractiveBackend::add_to_current_buffer(char c) {
 }
 
 void lk::InteractiveBackend::update_current_buffer_view() {
-    printf("\x1b[2K\x1b[0G%s%s\x1b[%zuG", m_prompt.c_str(), current_view().c_str(), current_view_cursor_pos());
-    fflush(stdout);
+    m_view_output.clear();
+    render_view(m_view_output);
+    if (!m_view_output.empty()) {
+        impl::write_output(m_view_output.data(), m_view_output.size());
+    }
+}
+
+void lk::InteractiveBackend::render_view(std::string& out) {
+    // while searching, the search takes the place of the prompt
+    const std::string& prompt = m_search_active ? m_search_prompt : m_prompt;
+    m_renderer.render(prompt, m_current_buffer, size_t(m_cursor_pos), size_t(m_terminal_size.width), out);
+    m_menu.render(m_autocomplete_index, m_renderer.cursor_column(), size_t(m_terminal_size.width), size_t(m_terminal_size.height), out);
 }
 
 void lk::InteractiveBackend::go_back() {
+    std::lock_guard<OptionalMutex> guard_history(m_history_mutex);
     if (m_history.empty()) {
         return;
     }
     go_back_in_history();
-    std::lock_guard<std::mutex> guard_history(m_history_mutex);
-    if (m_history_index == m_history.size()) {
-        m_current_buffer = m_history_temp_buffer;
-    } else {
-        m_current_buffer = m_history.at(m_history_index);
-    }
-    m_cursor_pos = (int)m_current_buffer.size();
-    update_current_buffer_view();
+    show_history_entry();
 }
 
 void lk::InteractiveBackend::go_forward() {
+    std::lock_guard<OptionalMutex> guard_history(m_history_mutex);
     if (m_history.empty()) {
         return;
     }
     go_forward_in_history();
-    std::lock_guard<std::mutex> guard_history(m_history_mutex);
+    show_history_entry();
+}
+
+void lk::InteractiveBackend::show_history_entry() {
     if (m_history_index == m_history.size()) {
         m_current_buffer = m_history_temp_buffer;
     } else {
@@ -80,6 +149,35 @@ void lk::InteractiveBackend::go_right() {
     }
 }
 
+void lk::InteractiveBackend::go_word_left() {
+    int pos = m_cursor_pos;
+    while (pos > 0 && m_current_buffer[pos - 1] == ' ') {
+        --pos;
+    }
+    while (pos > 0 && m_current_buffer[pos - 1] != ' ') {
+        --pos;
+    }
+    if (pos != m_cursor_pos) {
+        m_cursor_pos = pos;
+        update_current_buffer_view();
+    }
+}
+
+void lk::InteractiveBackend::go_word_right() {
+    const int size = int(m_current_buffer.size());
+    int pos = m_cursor_pos;
+    while (pos < size && m_current_buffer[pos] == ' ') {
+        ++pos;
+    }
+    while (pos < size && m_current_buffer[pos] != ' ') {
+        ++pos;
+    }
+    if (pos != m_cursor_pos) {
+        m_cursor_pos = pos;
+        update_current_buffer_view();
+    }
+}
+
 void lk::InteractiveBackend::go_to_begin() {
     if (m_cursor_pos > 0 && !m_current_buffer.empty()) {
         m_cursor_pos = 0;
@@ -92,43 +190,198 @@ void lk::InteractiveBackend::go_to_end() {
     update_current_buffer_view();
 }
 
-void lk::InteractiveBackend::handle_tab(std::unique_lock<std::mutex>& guard, bool forward) {
+void lk::InteractiveBackend::handle_tab(std::unique_lock<OptionalMutex>& guard, bool forward) {
     forward = impl::is_shift_pressed(forward);
 
-    if (m_autocomplete_suggestions.empty()) { // ensure we don't have suggestions already
-        if (on_autocomplete) { // request new ones if we don't
-            // we need to unlock the mutex here, because we call back into "userspace",
-            // which may want to print, which in turn then wants this mutex.
-            guard.unlock();
-            m_autocomplete_suggestions = on_autocomplete(*this, m_current_buffer, m_cursor_pos);
-            guard.lock();
-            m_autocomplete_index = 0;
-            m_buffer_before_autocomplete = m_current_buffer;
+    if (!has_suggestions()) { // ensure we don't have suggestions already
+        m_autocomplete_index = 0;
+        m_buffer_before_autocomplete = m_current_buffer;
+        m_completion_cursor = size_t(m_cursor_pos);
+        {
+            std::lock_guard<OptionalMutex> completions_guard(m_completions_mutex);
+            m_completion_matches = m_completions.complete(m_current_buffer, size_t(m_cursor_pos), m_fuzzy_completion.load() ? max_fuzzy_matches : 0);
         }
-        if (m_autocomplete_suggestions.empty()) {
+        if (m_completion_matches.empty() && on_autocomplete_async) {
+            request_autocomplete(guard);
+        }
+        if (!has_suggestions()) {
             return;
         }
+        show_suggestion_menu();
     } else { // we already have suggestions, so tab will loop through them
+        const size_t count = suggestion_count();
         if (forward) {
             ++m_autocomplete_index;
         } else {
-            --m_autocomplete_index;
+            m_autocomplete_index += count - 1;
         }
-        m_autocomplete_index %= m_autocomplete_suggestions.size();
+        m_autocomplete_index %= count;
     }
 
     // display current suggestion
-    m_current_buffer = m_autocomplete_suggestions.at(m_autocomplete_index);
-    go_to_end();
+    apply_suggestion(m_autocomplete_index);
+}
+
+bool lk::InteractiveBackend::has_suggestions() const {
+    return !m_completion_matches.empty() || !m_autocomplete_suggestions.empty();
+}
+
+size_t lk::InteractiveBackend::suggestion_count() const {
+    return m_completion_matches.empty() ? m_autocomplete_suggestions.size() : m_completion_matches.size();
+}
+
+// lays out the current suggestions in the menu, which is drawn with the next view update
+void lk::InteractiveBackend::show_suggestion_menu() {
+    const size_t count = suggestion_count();
+    if (count < 2) {
+        // a single suggestion is just applied
+        m_menu.clear();
+        return;
+    }
+    if (m_completion_matches.empty()) {
+        m_menu.set_entries(m_autocomplete_suggestions);
+        return;
+    }
+    std::vector<std::string> entries(count);
+    {
+        std::lock_guard<OptionalMutex> completions_guard(m_completions_mutex);
+        if (m_completion_matches.generation != m_completions.generation()) {
+            return;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            m_completions.append_name(m_completion_matches.node(i), entries[i]);
+        }
+    }
+    m_menu.set_entries(std::move(entries));
+}
+
+// arrow keys move through the menu while it's shown, like tab does
+bool lk::InteractiveBackend::handle_menu_key(const KeyEvent& key) {
+    const size_t count = m_menu.size();
+    if (count < 2 || key.mods != ModNone) {
+        return false;
+    }
+    const size_t columns = m_menu.columns();
+    size_t index = m_autocomplete_index;
+    switch (key.key) {
+    case Key::Right:
+        index = (index + 1) % count;
+        break;
+    case Key::Left:
+        index = (index + count - 1) % count;
+        break;
+    case Key::Down:
+        // wraps around to the top of the same column
+        index = index + columns < count ? index + columns : index % columns;
+        break;
+    case Key::Up:
+        if (index >= columns) {
+            index -= columns;
+        } else {
+            // the bottom of the same column, which may be one row up if the last row is short
+            index += (count - 1) / columns * columns;
+            if (index >= count) {
+                index -= columns;
+            }
+        }
+        break;
+    default:
+        return false;
+    }
+    m_autocomplete_index = index;
+    apply_suggestion(index);
+    return true;
+}
+
+void lk::InteractiveBackend::apply_suggestion(size_t index) {
+    if (m_completion_matches.empty()) {
+        m_current_buffer = m_autocomplete_suggestions.at(index);
+        go_to_end();
+        return;
+    }
+    // the whole word at the cursor is replaced with the match, including what's
+    // after the cursor, the rest of the buffer stays
+    std::lock_guard<OptionalMutex> completions_guard(m_completions_mutex);
+    if (m_completion_matches.generation != m_completions.generation()) {
+        // completions were added since, so the matches are gone
+        return;
+    }
+    m_current_buffer.assign(m_buffer_before_autocomplete, 0, m_completion_matches.word_begin);
+    m_completions.append_name(m_completion_matches.node(index), m_current_buffer);
+    m_cursor_pos = int(m_current_buffer.size());
+    size_t word_end = m_buffer_before_autocomplete.find(' ', m_completion_cursor);
+    if (word_end == std::string::npos) {
+        word_end = m_buffer_before_autocomplete.size();
+    }
+    m_current_buffer.append(m_buffer_before_autocomplete, word_end, std::string::npos);
+    update_current_buffer_view();
+}
+
+// hands a request for the current buffer to on_autocomplete_async. its result is
+// picked up by handle_wakeup(), or right here if it was completed before returning.
+void lk::InteractiveBackend::request_autocomplete(std::unique_lock<OptionalMutex>& guard) {
+    cancel_autocomplete_request();
+    auto request = std::make_shared<AutocompleteRequest::State>();
+    {
+        std::lock_guard<std::mutex> mailbox_guard(m_autocomplete_mailbox->mutex);
+        request->generation = ++m_autocomplete_mailbox->generation;
+        m_autocomplete_mailbox->has_result = false;
+        m_autocomplete_mailbox->result.clear();
+    }
+    request->buffer = m_current_buffer;
+    request->cursor = m_cursor_pos;
+    request->mailbox = m_autocomplete_mailbox;
+    m_autocomplete_request = request;
+    // we need to unlock the mutex here, because we call back into "userspace",
+    // which may want to print, which in turn then wants this mutex.
+    guard.unlock();
+    on_autocomplete_async(*this, AutocompleteRequest(request));
+    guard.lock();
+    receive_autocomplete_result();
+}
+
+// takes the result of the request in flight, if there is one. returns true if
+// that gave us new suggestions.
+bool lk::InteractiveBackend::receive_autocomplete_result() {
+    if (!m_autocomplete_request) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> mailbox_guard(m_autocomplete_mailbox->mutex);
+        if (!m_autocomplete_mailbox->has_result || m_autocomplete_mailbox->generation != m_autocomplete_request->generation) {
+            return false;
+        }
+        m_autocomplete_suggestions.swap(m_autocomplete_mailbox->result);
+        m_autocomplete_mailbox->has_result = false;
+        m_autocomplete_mailbox->result.clear();
+    }
+    const bool stale = m_current_buffer != m_autocomplete_request->buffer || m_cursor_pos != m_autocomplete_request->cursor;
+    m_autocomplete_request.reset();
+    if (stale) {
+        // keystrokes cancel the request, but the buffer can also change without them
+        m_autocomplete_suggestions.clear();
+        return false;
+    }
+    m_autocomplete_index = 0;
+    return !m_autocomplete_suggestions.empty();
+}
+
+void lk::InteractiveBackend::cancel_autocomplete_request() {
+    if (m_autocomplete_request) {
+        m_autocomplete_request->cancelled.store(true);
+        m_autocomplete_request.reset();
+    }
 }
 
 void lk::InteractiveBackend::clear_suggestions() {
     m_autocomplete_suggestions.clear();
+    m_menu.clear();
+    m_completion_matches = CompletionTree::Matches {};
     m_autocomplete_index = 0;
 }
 
 bool lk::InteractiveBackend::cancel_autocomplete_suggestion() {
-    if (!m_autocomplete_suggestions.empty()) {
+    if (has_suggestions()) {
         m_current_buffer = m_buffer_before_autocomplete;
         m_buffer_before_autocomplete.clear();
         clear_suggestions();
@@ -155,175 +408,689 @@ void lk::InteractiveBackend::handle_delete() {
     }
 }
 
-void lk::InteractiveBackend::handle_escape_sequence(std::unique_lock<std::mutex>& guard) {
-    int c2 = impl::getchar_no_echo();
-    if (m_key_debug) {
-        fprintf(stderr, "c2: 0x%.2x\n", c2);
+void lk::InteractiveBackend::start_search() {
+    m_search_active = true;
+    m_search_query.clear();
+    m_search_match = History::npos;
+    m_buffer_before_search = m_current_buffer;
+    clear_suggestions();
+    update_search(History::npos);
+}
+
+// searches for the query in entries before `before`, and shows the match (or the
+// failed search) in place of the current buffer
+void lk::InteractiveBackend::update_search(size_t before) {
+    size_t match;
+    {
+        std::lock_guard<OptionalMutex> guard(m_history_mutex);
+        match = m_history.search(m_search_query, before);
+        if (match != History::npos) {
+            m_current_buffer = m_history.at(match);
+        }
+    }
+    const bool failed = match == History::npos && !m_search_query.empty();
+    if (match != History::npos) {
+        m_search_match = match;
+        m_cursor_pos = int(m_current_buffer.find(m_search_query));
     }
+    m_search_prompt = failed ? "(failed reverse-i-search)`" : "(reverse-i-search)`";
+    m_search_prompt += m_search_query;
+    m_search_prompt += "': ";
+    update_current_buffer_view();
+}
 
-#if defined(UNIX)
-    int c3 = impl::getchar_no_echo();
-    if (m_key_debug) {
-        fprintf(stderr, "c3: 0x%.2x\n", c3);
+void lk::InteractiveBackend::end_search(bool accept) {
+    m_search_active = false;
+    if (!accept) {
+        m_current_buffer = m_buffer_before_search;
+    }
+    m_buffer_before_search.clear();
+    m_cursor_pos = int(m_current_buffer.size());
+    m_history_temp_buffer = m_current_buffer;
+    update_current_buffer_view();
+}
+
+// returns true if the key was consumed by the search. keys that aren't part of
+// the search end it, keeping the match, and are then handled as usual.
+bool lk::InteractiveBackend::handle_search_key(const KeyEvent& key, std::unique_lock<OptionalMutex>&) {
+    if (key.key == Key::Char && key.mods == ModCtrl && key.ch == 'r') {
+        // again: the next older match
+        update_search(m_search_match);
+        return true;
     }
-    if (c2 == '[' && history_enabled()) {
-        if (c3 == 'A') {
-            // up / back
+    if (key.key == Key::Char && key.mods == ModNone && isprint(static_cast<unsigned char>(key.ch))) {
+        m_search_query += key.ch;
+        // the current match may still match the longer query
+        update_search(m_search_match == History::npos ? History::npos : m_search_match + 1);
+        return true;
+    }
+    if (key.key == Key::Backspace) {
+        if (!m_search_query.empty()) {
+            m_search_query.pop_back();
+        }
+        m_search_match = History::npos;
+        update_search(History::npos);
+        return true;
+    }
+    if (key.key == Key::Escape || (key.key == Key::Char && key.mods == ModCtrl && key.ch == 'g')) {
+        end_search(false);
+        return true;
+    }
+    end_search(true);
+    return false;
+}
+
+void lk::InteractiveBackend::handle_key(const KeyEvent& key, std::unique_lock<OptionalMutex>& guard) {
+    if (m_search_active && handle_search_key(key, guard)) {
+        return;
+    }
+    if (handle_menu_key(key)) {
+        return;
+    }
+    const bool word_jump = key.mods & (ModCtrl | ModAlt);
+    switch (key.key) {
+    case Key::Char:
+        if (key.mods == ModNone && isprint(static_cast<unsigned char>(key.ch))) {
+            // cleared first, so that the menu is gone when the buffer is redrawn
+            clear_suggestions();
+            add_to_current_buffer(key.ch);
+        } else if (key.mods == ModCtrl && key.ch == 'r' && history_enabled()) {
+            start_search();
+        } else if (m_key_debug) {
+            fprintf(stderr, "unhandled: 0x%.2x mods: %d\n", static_cast<unsigned char>(key.ch), key.mods);
+        }
+        break;
+    case Key::Backspace:
+        handle_backspace();
+        clear_suggestions();
+        break;
+    case Key::Tab:
+        handle_tab(guard, true);
+        break;
+    case Key::BackTab:
+        handle_tab(guard, false);
+        break;
+    case Key::Delete:
+        handle_delete();
+        break;
+    case Key::Up:
+        if (history_enabled()) {
             go_back();
-        } else if (c3 == 'B') {
-            // down / forward
+        }
+        break;
+    case Key::Down:
+        if (history_enabled()) {
             go_forward();
-        } else if (c3 == 'D') {
-            // left
-            go_left();
-        } else if (c3 == 'C') {
-            // right
-            go_right();
-        } else if (c3 == 0x48 || c3 == 0x31) {
-            // HOME
-            go_to_begin();
-        } else if (c3 == 0x46) {
-            // END
-            go_to_end();
-        } else if (c3 == 0x33) {
-            // DEL
-            int c4 = impl::getchar_no_echo();
-            if (c4 == '~') {
-                handle_delete();
-            }
-        } else if (c3 == 0x5a) {
-            // SHIFT+TAB
-            handle_tab(guard, false);
-        }
-#elif defined(WINDOWS)
-    if (c2 == 'H') {
-        // up / back
-        go_back();
-    } else if (c2 == 'P') {
-        // down / forward
-        go_forward();
-    } else if (c2 == 'K') {
-        // left
-        go_left();
-    } else if (c2 == 'M') {
-        // right
-        go_right();
-    } else if (c2 == 0x47) {
-        // HOME
+        }
+        break;
+    case Key::Left:
+        word_jump ? go_word_left() : go_left();
+        break;
+    case Key::Right:
+        word_jump ? go_word_right() : go_right();
+        break;
+    case Key::Home:
         go_to_begin();
-    } else if (c2 == 0x4f) {
-        // END
+        break;
+    case Key::End:
         go_to_end();
-    } else if (c2 == 0x53) {
-        // DEL
-        handle_delete();
-#endif
+        break;
+    case Key::Escape:
+        cancel_autocomplete_suggestion();
+        break;
+    default:
+        if (m_key_debug) {
+            fprintf(stderr, "unhandled key: %d mods: %d\n", int(key.key), key.mods);
+        }
+        break;
+    }
+}
+
+void lk::InteractiveBackend::handle_paste(const std::string& text, std::unique_lock<OptionalMutex>& guard) {
+    clear_suggestions();
+    // every complete line is committed as a command, like it would be when typed,
+    // and whatever follows the last newline is spliced in at the cursor. the
+    // buffer is modified once per line and redrawn once for the whole paste.
+    std::string line;
+    line.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        const char c = text[i];
+        if (c == '\r' || c == '\n') {
+            m_current_buffer.insert(size_t(m_cursor_pos), line);
+            line.clear();
+            commit_current_buffer(guard);
+            if (c == '\r' && i + 1 < text.size() && text[i + 1] == '\n') {
+                ++i;
+            }
+        } else if (c == '\t') {
+            line.push_back(' ');
+        } else if (isprint(static_cast<unsigned char>(c))) {
+            line.push_back(c);
+        }
+    }
+    m_current_buffer.insert(size_t(m_cursor_pos), line);
+    m_cursor_pos += int(line.size());
+    m_history_temp_buffer = m_current_buffer;
+    update_current_buffer_view();
+}
+
+void lk::InteractiveBackend::commit_current_buffer(std::unique_lock<OptionalMutex>& guard) {
+    if (history_enabled() && m_current_buffer.size() > 0) {
+        add_to_history(m_current_buffer);
+    }
+    {
+        std::lock_guard<std::mutex> guard_to_read(m_to_read_mutex);
+        if (m_to_read.empty()) {
+            impl::signal_wakeup_pipe(m_command_pipe);
+        }
+        m_to_read.push_back(m_current_buffer);
+    }
+    m_to_read_cond.notify_all();
+    m_current_buffer.clear();
+    m_cursor_pos = 0;
+    clear_suggestions();
+    if (on_command) {
+        // on_command may want to write, which needs the buffer mutex
+        guard.unlock();
+        on_command(*this);
+        guard.lock();
+    }
+}
+
+bool lk::InteractiveBackend::poll_input(int timeout_ms) {
+    const bool pending = m_key_decoder.pending();
+    if (pending) {
+        timeout_ms = m_escape_timeout_ms.load();
+    }
+    if (m_autocomplete_request && m_wakeup_pipe.read_fd == -1 && (timeout_ms < 0 || timeout_ms > impl::wakeup_poll_interval_ms)) {
+        // without a wakeup pipe (windows), autocomplete results are polled for
+        timeout_ms = impl::wakeup_poll_interval_ms;
+    }
+    bool woken = false;
+    const bool ready = impl::wait_for_input(timeout_ms, m_wakeup_pipe, woken);
+    if (m_shutdown.load()) {
+        // woken up by the destructor, don't touch the screen anymore
+        return false;
+    }
+    if (woken || m_autocomplete_request) {
+        handle_wakeup(woken);
+    }
+    if (ready) {
+        // one read() for everything that's available, so that pastes and
+        // fast typing don't cost a syscall per byte
+        int n = impl::read_input(m_input_buffer, sizeof(m_input_buffer));
+        if (n <= 0) {
+            // stdin is gone (EOF or error), nothing more to read
+            m_stdin_closed = true;
+            close_input();
+            return false;
+        }
+        decode_input(m_input_buffer, size_t(n));
+    } else if (pending && !woken) {
+        // nothing followed the start of an escape sequence in time,
+        // so it was most likely a lone ESC keypress
+        m_key_decoder.flush(m_keys);
+    }
+    return true;
+}
+
+void lk::InteractiveBackend::handle_wakeup(bool woken) {
+    std::lock_guard<OptionalMutex> guard(m_current_buffer_mutex);
+    if (woken) {
+        impl::drain_wakeup_pipe(m_wakeup_pipe);
+    }
+    // any number of resizes since the last time result in one re-layout
+    if (impl::take_terminal_resize()) {
+        m_terminal_size = impl::get_terminal_size();
+        m_renderer.invalidate();
+        m_menu.invalidate();
+    }
+    if (receive_autocomplete_result()) {
+        show_suggestion_menu();
+        apply_suggestion(m_autocomplete_index);
     } else {
-        add_to_current_buffer(c2);
-#if defined(UNIX)
-        add_to_current_buffer(c3);
-#endif
+        update_current_buffer_view();
+    }
+}
+
+void lk::InteractiveBackend::decode_input(const char* data, size_t size) {
+    if (m_key_debug) {
+        for (size_t i = 0; i < size; ++i) {
+            fprintf(stderr, "c: 0x%.2x\n", static_cast<unsigned char>(data[i]));
+        }
     }
+    m_key_decoder.feed(data, size, m_keys);
+}
+
+void lk::InteractiveBackend::handle_keys() {
+    std::unique_lock<OptionalMutex> guard(m_current_buffer_mutex);
+    for (const auto& key : m_keys) {
+        if (m_shutdown.load()) {
+            // dont do anything on the last pass before exit
+            break;
+        }
+        if (key.key != Key::Tab && key.key != Key::BackTab) {
+            // the buffer is about to change, so the suggestions would be for an outdated one
+            cancel_autocomplete_request();
+        }
+        if (m_search_active && (key.key == Key::Enter || key.key == Key::Paste)) {
+            // accept the match, enter then runs it like readline does
+            end_search(true);
+        }
+        if (key.key == Key::Enter) {
+            commit_current_buffer(guard);
+            update_current_buffer_view();
+        } else if (key.key == Key::Paste) {
+            handle_paste(key.text, guard);
+        } else {
+            handle_key(key, guard);
+        }
+    }
+    m_keys.clear();
 }
 
 void lk::InteractiveBackend::input_thread_main() {
+    {
+        std::lock_guard<OptionalMutex> guard(m_current_buffer_mutex);
+        update_current_buffer_view();
+    }
+    // the destructor wakes us through the wakeup pipe. without one (windows),
+    // look for the shutdown every so often
+    const int timeout_ms = m_wakeup_pipe.read_fd == -1 ? impl::wakeup_poll_interval_ms : -1;
     while (!m_shutdown.load()) {
-        int c = 0;
-        while (c != '\n' && c != '\r' && !m_shutdown.load()) {
-            update_current_buffer_view();
-            c = impl::getchar_no_echo();
-            if (m_key_debug) {
-                fprintf(stderr, "c: 0x%.2x\n", c);
-            }
-            std::unique_lock<std::mutex> guard(m_current_buffer_mutex);
-            if (c != '\t') {
-            }
-            if (c == '\b' || c == 127) { // backspace or other delete sequence
-                handle_backspace();
-                clear_suggestions();
-            } else if (c == '\t') {
-                handle_tab(guard, true);
-            } else if (isprint(c)) {
-                add_to_current_buffer(c);
-                clear_suggestions();
-            } else if (c == 0x1b) { // escape sequence
-#if defined(UNIX)
-                handle_escape_sequence(guard);
-#else
-                cancel_autocomplete_suggestion();
-#endif
-            } else if (c == 0xe0) { // escape sequence
-#if defined(WINDOWS)
-                handle_escape_sequence(guard);
-#endif
-            } else {
-                if (m_key_debug) {
-                    fprintf(stderr, "unhandled: 0x%.2x\n", c);
-                }
-            }
+        if (!poll_input(timeout_ms)) {
+            return;
         }
-        bool shutdown = m_shutdown.load();
-        // check so we dont do anything on the last pass before exit
-        if (!shutdown) {
-            if (history_enabled() && m_current_buffer.size() > 0) {
-                add_to_history(m_current_buffer);
-            }
-            std::lock_guard<std::mutex> guard(m_to_read_mutex);
-            m_to_read.push(m_current_buffer);
-            m_current_buffer.clear();
-            m_cursor_pos = 0;
-            update_current_buffer_view();
+        handle_keys();
+    }
+}
+
+bool lk::InteractiveBackend::poll_once(std::chrono::milliseconds timeout) {
+    if (m_threaded) {
+        return false;
+    }
+    t_io_thread_backend = this;
+    flush_output(false);
+    if (!m_output_lines.empty()) {
+        // don't sleep past the frame that prints the held back lines
+        const auto until_render = std::chrono::duration_cast<std::chrono::milliseconds>(next_render() - std::chrono::steady_clock::now()) + std::chrono::milliseconds(1);
+        if (timeout.count() < 0 || until_render < timeout) {
+            timeout = until_render;
         }
-        if (on_command && !shutdown) {
-            on_command(*this);
+    }
+    if (m_wakeup_pipe.read_fd == -1 && (timeout.count() < 0 || timeout.count() > impl::wakeup_poll_interval_ms)) {
+        // without a wakeup pipe (windows), writes from other threads can't wake us up,
+        // so look for them every so often
+        timeout = std::chrono::milliseconds(impl::wakeup_poll_interval_ms);
+    }
+    // we're the io thread now, so writes from other threads wake us through the
+    // wakeup pipe, see notify_written()
+    m_io_thread_waiting.store(true);
+    if (!m_to_write.empty()) {
+        timeout = std::chrono::milliseconds(0);
+    }
+    if (m_stdin_closed) {
+        // nothing to read anymore, but writes and resizes still wake us up
+        const bool woken = impl::wait_for_wakeup_pipe(int(timeout.count()), m_wakeup_pipe);
+        if (woken || m_autocomplete_request) {
+            handle_wakeup(woken);
         }
+    } else {
+        poll_input(int(timeout.count()));
+    }
+    m_io_thread_waiting.store(false);
+    const bool handled = !m_keys.empty();
+    handle_keys();
+    flush_output(false);
+    return handled;
+}
+
+void lk::InteractiveBackend::process_input(const char* data, size_t size) {
+    if (m_threaded) {
+        return;
     }
+    t_io_thread_backend = this;
+    decode_input(data, size);
+    handle_keys();
+    // the owner waits for stdin, not for the wakeup pipe, so resizes and autocomplete
+    // results that arrived in the meantime are picked up here
+    handle_wakeup(true);
+    flush_output(false);
 }
 
 void lk::InteractiveBackend::io_thread_main() {
-    std::thread input_thread(&lk::InteractiveBackend::input_thread_main, this);
-    input_thread.detach();
-    while (!m_shutdown.load()) {
-        std::unique_lock<std::mutex> guard(m_to_write_mutex);
-        m_to_write_cond.wait(guard, [&] { return !m_to_write.empty() || m_shutdown.load(); });
-        if (!m_to_write.empty()) {
-            auto to_write = m_to_write.front();
-            m_to_write.pop();
-            std::lock_guard<std::mutex> guard2(m_current_buffer_mutex);
-            printf("\x1b[2K\x1b[0G%s\n%s%s\x1b[%zuG", to_write.c_str(), m_prompt.c_str(), current_view().c_str(), current_view_cursor_pos());
-            fflush(stdout);
-            if (on_write) {
-                on_write(to_write);
-            }
+    t_io_thread_backend = this;
+    bool shutdown = false;
+    while (!shutdown) {
+        {
+            std::unique_lock<std::mutex> guard(m_to_write_mutex);
+            m_io_thread_waiting.store(true);
+            m_to_write_cond.wait(guard, [&] { return !m_to_write.empty() || m_shutdown.load(); });
+            m_io_thread_waiting.store(false);
+            shutdown = m_shutdown.load();
+        }
+        collect_output();
+        // with a render rate, keep collecting (and passing lines to on_write) until
+        // the next frame is due, then print everything at once
+        const auto next_frame = next_render();
+        while (!shutdown && std::chrono::steady_clock::now() < next_frame && !m_flush_requested.load()) {
+            std::unique_lock<std::mutex> guard(m_to_write_mutex);
+            m_io_thread_waiting.store(true);
+            m_to_write_cond.wait_until(guard, next_frame, [&] { return !m_to_write.empty() || m_shutdown.load() || m_flush_requested.load(); });
+            m_io_thread_waiting.store(false);
+            shutdown = m_shutdown.load();
+            guard.unlock();
+            collect_output();
         }
+        render_output(shutdown);
     }
-    // after all this, we have to output all that remains in the buffer, so we dont "lose" information
-    std::unique_lock<std::mutex> guard(m_to_write_mutex);
-    while (!m_to_write.empty()) {
-        auto to_write = m_to_write.front();
-        m_to_write.pop();
-        printf("\x1b[2K\x1b[0G%s", to_write.c_str());
-        if (on_write) {
-            on_write(to_write);
+}
+
+void lk::InteractiveBackend::flush_output(bool final) {
+    collect_output();
+    if (final || std::chrono::steady_clock::now() >= next_render()) {
+        render_output(final);
+    }
+}
+
+std::chrono::steady_clock::time_point lk::InteractiveBackend::next_render() const {
+    const unsigned rate = m_render_rate.load();
+    if (rate == 0 || m_flush_requested.load()) {
+        return m_last_render;
+    }
+    return m_last_render + std::chrono::microseconds(1000000 / rate);
+}
+
+void lk::InteractiveBackend::collect_output() {
+    // take everything that's queued, so a burst of writes costs one redraw. each
+    // popped line leaves a printed line's buffer in the queue for writers to reuse.
+    std::string popped = take_spare_line();
+    while (m_to_write.pop(popped)) {
+        m_output_bytes += popped.size();
+        m_collected.push_back(std::move(popped));
+        popped = take_spare_line();
+    }
+    recycle_line(popped);
+    if (m_collected.empty()) {
+        return;
+    }
+    // on_write gets every line right away, even if it's not on the screen yet
+    // or gets trimmed by the write limit before it is
+    dispatch_write(m_collected);
+    m_output_lines.insert(m_output_lines.end(), std::make_move_iterator(m_collected.begin()), std::make_move_iterator(m_collected.end()));
+    m_collected.clear();
+}
+
+std::string lk::InteractiveBackend::take_spare_line() {
+    if (m_spare_lines.empty()) {
+        return std::string();
+    }
+    std::string line = std::move(m_spare_lines.back());
+    m_spare_lines.pop_back();
+    return line;
+}
+
+void lk::InteractiveBackend::recycle_line(std::string& line) {
+    // keeps enough buffers around for the usual number of lines per frame, but
+    // doesn't hold on to the memory of an unusual burst or an unusually long line
+    if (m_spare_lines.size() < max_spare_lines && line.capacity() <= max_spare_line_capacity) {
+        line.clear();
+        m_spare_lines.push_back(std::move(line));
+    }
+}
+
+void lk::InteractiveBackend::render_output(bool final) {
+    m_flush_requested.store(false);
+    if (m_output_lines.empty()) {
+        return;
+    }
+    // the lines only stop counting against the write limit once they're on the screen
+    m_pending_lines.fetch_sub(m_output_lines.size());
+    m_pending_bytes.fetch_sub(m_output_bytes);
+    m_output_bytes = 0;
+    if (m_blocked_writers.load() > 0) {
+        {
+            std::lock_guard<std::mutex> guard(m_space_mutex);
         }
+        m_space_cond.notify_all();
     }
-    fflush(stdout);
+    trim_to_write_limit(m_output_lines);
+    m_output.clear();
+    // erases the prompt line and the suggestion menu below it
+    m_output += "\x1b[0G\x1b[J";
+    for (const auto& line : m_output_lines) {
+        m_output += line;
+        m_output += '\n';
+    }
+    {
+        std::lock_guard<OptionalMutex> guard(m_current_buffer_mutex);
+        m_renderer.cleared();
+        m_menu.cleared();
+        // on the final flush, we only output all that remains in the buffer, so we dont "lose" information
+        if (!final) {
+            render_view(m_output);
+        }
+        impl::write_output(m_output.data(), m_output.size());
+    }
+    for (auto& line : m_output_lines) {
+        recycle_line(line);
+    }
+    m_output_lines.clear();
+    m_last_render = std::chrono::steady_clock::now();
 }
 
-void lk::InteractiveBackend::add_to_history(const std::string& str) {
-    std::lock_guard<std::mutex> guard(m_history_mutex);
-    // if adding one entry would put us over the limit,
-    // remove the oldest one before adding one
-    if (m_history.size() + 1 > m_history_limit) {
-        m_history.erase(m_history.begin());
+bool lk::InteractiveBackend::over_write_limit(size_t lines, size_t bytes) const {
+    // a line is always accepted into an empty queue, even if it's larger than the byte limit on its own
+    if (lines <= 1) {
+        return false;
+    }
+    const size_t max_lines = m_max_pending_lines.load();
+    const size_t max_bytes = m_max_pending_bytes.load();
+    return (max_lines != 0 && lines > max_lines) || (max_bytes != 0 && bytes > max_bytes);
+}
+
+void lk::InteractiveBackend::trim_to_write_limit(std::vector<std::string>& lines) {
+    const OverflowPolicy policy = m_overflow_policy.load();
+    if (policy != OverflowPolicy::DropOldest && policy != OverflowPolicy::Collapse) {
+        return;
+    }
+    size_t bytes = 0;
+    for (const auto& line : lines) {
+        bytes += line.size();
+    }
+    size_t drop = 0;
+    while (over_write_limit(lines.size() - drop, bytes)) {
+        bytes -= lines[drop].size();
+        ++drop;
+    }
+    lines.erase(lines.begin(), lines.begin() + std::ptrdiff_t(drop));
+    const size_t dropped = m_dropped_lines.fetch_add(drop) + drop;
+    // the marker also covers lines that writers dropped themselves since the last one
+    if (policy == OverflowPolicy::Collapse && dropped != m_reported_dropped_lines) {
+        lines.insert(lines.begin(), "[" + std::to_string(dropped - m_reported_dropped_lines) + " lines dropped]");
+        m_reported_dropped_lines = dropped;
+    }
+}
+
+void lk::InteractiveBackend::set_write_limit(size_t max_lines, size_t max_bytes, OverflowPolicy policy) {
+    m_max_pending_lines.store(max_lines);
+    m_max_pending_bytes.store(max_bytes);
+    m_overflow_policy.store(policy);
+    // blocked writers may fit now
+    {
+        std::lock_guard<std::mutex> guard(m_space_mutex);
+    }
+    m_space_cond.notify_all();
+}
+
+void lk::InteractiveBackend::add_completion(const std::string& line) {
+    std::lock_guard<OptionalMutex> guard(m_completions_mutex);
+    m_completions.add(line);
+}
+
+void lk::InteractiveBackend::add_completions(const std::vector<std::string>& lines) {
+    std::lock_guard<OptionalMutex> guard(m_completions_mutex);
+    m_completions.add(lines);
+}
+
+void lk::InteractiveBackend::clear_completions() {
+    std::lock_guard<OptionalMutex> guard(m_completions_mutex);
+    m_completions.clear();
+}
+
+void lk::InteractiveBackend::set_render_rate(unsigned frames_per_second) {
+    m_render_rate.store(frames_per_second);
+}
+
+// the terminal is written to a frame at a time instead, see set_render_rate()
+void lk::InteractiveBackend::set_output_buffering(size_t, std::chrono::milliseconds) {
+}
+
+// nothing is held back in an OutputBuffer
+void lk::InteractiveBackend::set_flush_on_termination_signals(bool) {
+}
+
+void lk::InteractiveBackend::flush() {
+    if (!m_threaded) {
+        collect_output();
+        render_output(false);
+        return;
     }
-    m_history.push_back(str);
+    m_flush_requested.store(true);
+    wake_io_thread();
+}
+
+void lk::InteractiveBackend::add_to_history(const std::string& str) {
+    std::lock_guard<OptionalMutex> guard(m_history_mutex);
+    // evicts the oldest entries if this goes over the limits
+    const bool added = m_history.push(str);
     m_history_index = m_history.size(); // point to one after last one
     m_history_temp_buffer.clear();
+    if (added && m_history_fd != -1) {
+        m_history_line.assign(str);
+        m_history_line += '\n';
+        impl::append_file(m_history_fd, m_history_line.data(), m_history_line.size());
+        ++m_history_file_lines;
+        m_history_file_bytes += m_history_line.size();
+        // the file may grow to twice the limits, so that compacting it is rare
+        const size_t max_entries = m_history.max_entries();
+        const size_t max_bytes = m_history.max_bytes();
+        if ((max_entries != 0 && m_history_file_lines > 2 * max_entries)
+            || (max_bytes != 0 && m_history_file_bytes > 2 * max_bytes)) {
+            rewrite_history_file();
+        }
+    }
+}
+
+bool lk::InteractiveBackend::set_history_file(const std::string& path) {
+    std::lock_guard<OptionalMutex> guard(m_history_mutex);
+    impl::close_file(m_history_fd);
+    m_history_file_path = path;
+    m_history_fd = impl::open_append_file(path);
+    if (m_history_fd == -1) {
+        return false;
+    }
+    impl::MappedFile file;
+    if (!impl::map_file(path, file)) {
+        impl::close_file(m_history_fd);
+        m_history_fd = -1;
+        return false;
+    }
+    load_history_file(file);
+    impl::unmap_file(file);
+    return true;
+}
+
+void lk::InteractiveBackend::load_history_file(const impl::MappedFile& file) {
+    // one pass over the mapped file to find where each line starts, then only
+    // the newest lines that fit into the limits are copied into the history
+    std::vector<size_t> line_begins;
+    size_t pos = 0;
+    while (pos < file.size) {
+        line_begins.push_back(pos);
+        const void* newline = std::memchr(file.data + pos, '\n', file.size - pos);
+        pos = newline ? size_t(static_cast<const char*>(newline) - file.data) + 1 : file.size;
+    }
+    line_begins.push_back(file.size);
+    m_history_file_lines = line_begins.size() - 1;
+    m_history_file_bytes = file.size;
+    // the size of line `i` without its newline, which the last line may not have
+    const auto line_size = [&](size_t i) {
+        size_t size = line_begins[i + 1] - line_begins[i];
+        if (file.data[line_begins[i + 1] - 1] == '\n') {
+            --size;
+        }
+        return size;
+    };
+    const size_t max_entries = m_history.max_entries();
+    const size_t max_bytes = m_history.max_bytes();
+    size_t first = m_history_file_lines;
+    size_t bytes = 0;
+    while (first > 0 && (max_entries == 0 || m_history_file_lines - first < max_entries)) {
+        const size_t size = line_size(first - 1);
+        if (max_bytes != 0 && bytes + size > max_bytes) {
+            break;
+        }
+        bytes += size;
+        --first;
+    }
+    m_history.clear();
+    for (size_t i = first; i < m_history_file_lines; ++i) {
+        const size_t size = line_size(i);
+        if (size > 0) {
+            m_history.push(file.data + line_begins[i], size);
+        }
+    }
+    m_history_index = m_history.size();
+    // a last line without a newline (e.g. from a crash) would be joined with the next entry
+    if (file.size > 0 && file.data[file.size - 1] != '\n') {
+        impl::append_file(m_history_fd, "\n", 1);
+        ++m_history_file_bytes;
+    }
+}
+
+void lk::InteractiveBackend::rewrite_history_file() {
+    if (m_history_fd == -1) {
+        return;
+    }
+    // written next to the old file and then renamed over it, so that it's never half-written
+    const std::string tmp_path = m_history_file_path + ".tmp";
+    // created like the history file itself, so that the history stays private
+    const int fd = impl::create_private_file(tmp_path);
+    if (fd == -1) {
+        return;
+    }
+    // written in chunks of whole entries
+    const size_t chunk_size = 64 * 1024;
+    bool ok = true;
+    size_t bytes = 0;
+    m_history_line.clear();
+    for (size_t i = 0; i < m_history.size() && ok; ++i) {
+        const std::string& entry = m_history.at(i);
+        m_history_line += entry;
+        m_history_line += '\n';
+        bytes += entry.size() + 1;
+        if (m_history_line.size() >= chunk_size) {
+            ok = impl::append_file(fd, m_history_line.data(), m_history_line.size());
+            m_history_line.clear();
+        }
+    }
+    if (ok && !m_history_line.empty()) {
+        ok = impl::append_file(fd, m_history_line.data(), m_history_line.size());
+    }
+    impl::close_file(fd);
+    if (!ok || !impl::replace_file(tmp_path, m_history_file_path)) {
+        std::remove(tmp_path.c_str());
+        return;
+    }
+    // the old fd still points at the replaced file
+    impl::close_file(m_history_fd);
+    m_history_fd = impl::open_append_file(m_history_file_path);
+    m_history_file_lines = m_history.size();
+    m_history_file_bytes = bytes;
 }
 
 void lk::InteractiveBackend::go_back_in_history() {
-    std::lock_guard<std::mutex> guard(m_history_mutex);
     if (m_history_index == 0) {
         return;
     } else {
@@ -332,7 +1099,6 @@ void lk::InteractiveBackend::go_back_in_history() {
 }
 
 void lk::InteractiveBackend::go_forward_in_history() {
-    std::lock_guard<std::mutex> guard(m_history_mutex);
     if (m_history_index == m_history.size()) {
         return;
     } else {
@@ -341,8 +1107,77 @@ void lk::InteractiveBackend::go_forward_in_history() {
 }
 
 void lk::InteractiveBackend::write(const std::string& str) {
-    std::lock_guard<std::mutex> guard(m_to_write_mutex);
-    m_to_write.push(str);
+    write(str.data(), str.size());
+}
+
+void lk::InteractiveBackend::write(std::string&& str) {
+    if (!reserve_write(str.size())) {
+        return;
+    }
+    // no copy, the recycled buffer goes to the caller instead
+    m_to_write.push_into([&](std::string& line) { line.swap(str); });
+    notify_written();
+}
+
+void lk::InteractiveBackend::write(const char* data, size_t size) {
+    if (!reserve_write(size)) {
+        return;
+    }
+    // reuses the buffer of a line that was already printed, if there is one
+    m_to_write.push_into([&](std::string& line) { line.assign(data, size); });
+    notify_written();
+}
+
+bool lk::InteractiveBackend::reserve_write(size_t size) {
+    const size_t lines = m_pending_lines.fetch_add(1) + 1;
+    const size_t bytes = m_pending_bytes.fetch_add(size) + size;
+    if (over_write_limit(lines, bytes)) {
+        const OverflowPolicy policy = m_overflow_policy.load();
+        if (policy == OverflowPolicy::Block && t_io_thread_backend != this) {
+            m_pending_lines.fetch_sub(1);
+            m_pending_bytes.fetch_sub(size);
+            std::unique_lock<std::mutex> guard(m_space_mutex);
+            m_blocked_writers.fetch_add(1);
+            m_space_cond.wait(guard, [&] {
+                return m_shutdown.load() || !over_write_limit(m_pending_lines.load() + 1, m_pending_bytes.load() + size);
+            });
+            m_blocked_writers.fetch_sub(1);
+            m_pending_lines.fetch_add(1);
+            m_pending_bytes.fetch_add(size);
+        } else if (policy == OverflowPolicy::DropNewest
+            // the oldest lines are dropped by the io thread once it gets to them. if it's stuck
+            // (e.g. on a slow terminal) the queue would still grow, so past twice the limit
+            // the newest line is dropped instead
+            || over_write_limit(lines / 2, bytes / 2)) {
+            m_pending_lines.fetch_sub(1);
+            m_pending_bytes.fetch_sub(size);
+            m_dropped_lines.fetch_add(1);
+            return false;
+        }
+    }
+    return true;
+}
+
+void lk::InteractiveBackend::notify_written() {
+    // only pay for the wake-up if the io thread is actually asleep. the queue
+    // push and this load are both seq_cst, and the io thread sets the flag before
+    // checking the queue, so either it sees our line or we see it waiting.
+    if (m_io_thread_waiting.load()) {
+        wake_io_thread();
+    }
+}
+
+void lk::InteractiveBackend::wake_io_thread() {
+    if (!m_threaded) {
+        // the owner's thread is waiting for input in poll_once()
+        impl::signal_wakeup_pipe(m_wakeup_pipe);
+        return;
+    }
+    {
+        // taking the mutex ensures the io thread is either inside wait() or hasn't
+        // checked its predicate yet, so the notification can't get lost
+        std::lock_guard<std::mutex> guard(m_to_write_mutex);
+    }
     m_to_write_cond.notify_one();
 }
 
@@ -353,24 +1188,120 @@ bool lk::InteractiveBackend::has_command() const {
 
 std::string lk::InteractiveBackend::get_command() {
     std::lock_guard<std::mutex> guard(m_to_read_mutex);
-    auto res = m_to_read.front();
-    m_to_read.pop();
+    auto res = std::move(m_to_read.front());
+    m_to_read.pop_front();
+    if (m_to_read.empty()) {
+        impl::drain_wakeup_pipe(m_command_pipe);
+    }
+    return res;
+}
+
+std::vector<std::string> lk::InteractiveBackend::get_commands() {
+    std::lock_guard<std::mutex> guard(m_to_read_mutex);
+    std::vector<std::string> res(std::make_move_iterator(m_to_read.begin()), std::make_move_iterator(m_to_read.end()));
+    m_to_read.clear();
+    impl::drain_wakeup_pipe(m_command_pipe);
     return res;
 }
 
+size_t lk::InteractiveBackend::get_command_views(std::vector<CommandView>& views, size_t max) {
+    {
+        std::lock_guard<std::mutex> guard(m_to_read_mutex);
+        const size_t count = std::min(max, m_to_read.size());
+        m_view_commands.assign(std::make_move_iterator(m_to_read.begin()), std::make_move_iterator(m_to_read.begin() + std::ptrdiff_t(count)));
+        m_to_read.erase(m_to_read.begin(), m_to_read.begin() + std::ptrdiff_t(count));
+        if (m_to_read.empty()) {
+            impl::drain_wakeup_pipe(m_command_pipe);
+        }
+    }
+    for (const auto& command : m_view_commands) {
+        views.emplace_back(command.data(), command.size());
+    }
+    return m_view_commands.size();
+}
+
+bool lk::InteractiveBackend::wait_for_command() {
+    if (!m_threaded) {
+        // nobody else is going to read input, so drive it from here
+        while (!has_command() && !m_stdin_closed) {
+            poll_once(std::chrono::milliseconds(-1));
+        }
+        return has_command();
+    }
+    std::unique_lock<std::mutex> guard(m_to_read_mutex);
+    m_to_read_cond.wait(guard, [&] { return !m_to_read.empty() || m_input_closed; });
+    return !m_to_read.empty();
+}
+
+bool lk::InteractiveBackend::wait_for_command(std::chrono::milliseconds timeout) {
+    if (!m_threaded) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        auto now = std::chrono::steady_clock::now();
+        while (!has_command() && !m_stdin_closed && now < deadline) {
+            poll_once(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now));
+            now = std::chrono::steady_clock::now();
+        }
+        return has_command();
+    }
+    std::unique_lock<std::mutex> guard(m_to_read_mutex);
+    m_to_read_cond.wait_for(guard, timeout, [&] { return !m_to_read.empty() || m_input_closed; });
+    return !m_to_read.empty();
+}
+
+void lk::InteractiveBackend::close_input() {
+    {
+        std::lock_guard<std::mutex> guard(m_to_read_mutex);
+        m_input_closed = true;
+    }
+    m_to_read_cond.notify_all();
+}
+
 void lk::InteractiveBackend::set_history_limit(size_t count) {
-    std::lock_guard<std::mutex> guard(m_history_mutex);
-    m_history_limit = count;
+    std::lock_guard<OptionalMutex> guard(m_history_mutex);
+    m_history.set_limits(count, m_history.max_bytes());
+    m_history_index = m_history.size();
+}
+
+void lk::InteractiveBackend::set_history_byte_limit(size_t bytes) {
+    std::lock_guard<OptionalMutex> guard(m_history_mutex);
+    m_history.set_limits(m_history.max_entries(), bytes);
+    m_history_index = m_history.size();
+}
+
+void lk::InteractiveBackend::set_history_ignore_duplicates(bool ignore) {
+    std::lock_guard<OptionalMutex> guard(m_history_mutex);
+    m_history.set_ignore_duplicates(ignore);
+}
+
+std::vector<std::string> lk::InteractiveBackend::history() const {
+    std::lock_guard<OptionalMutex> guard(m_history_mutex);
+    return m_history.to_vector();
+}
+
+void lk::InteractiveBackend::set_history(const std::vector<std::string>& history) {
+    std::lock_guard<OptionalMutex> guard(m_history_mutex);
+    m_history.clear();
+    for (const auto& entry : history) {
+        m_history.push(entry);
+    }
+    m_history_index = m_history.size();
+    rewrite_history_file();
 }
 
 size_t lk::InteractiveBackend::history_size() const {
-    std::lock_guard<std::mutex> guard(m_history_mutex);
+    std::lock_guard<OptionalMutex> guard(m_history_mutex);
     return m_history.size();
 }
 
 void lk::InteractiveBackend::clear_history() {
-    std::lock_guard<std::mutex> guard(m_history_mutex);
+    std::lock_guard<OptionalMutex> guard(m_history_mutex);
     m_history.clear();
+    m_history_index = 0;
+    rewrite_history_file();
+}
+
+void lk::InteractiveBackend::set_escape_timeout(std::chrono::milliseconds timeout) {
+    m_escape_timeout_ms.store(int(timeout.count()));
 }
 
 void lk::InteractiveBackend::enable_key_debug() {
@@ -380,44 +1311,3 @@ void lk::InteractiveBackend::enable_key_debug() {
 void lk::InteractiveBackend::disable_key_debug() {
     m_key_debug = false;
 }
-std::string lk::InteractiveBackend::current_view() {
-    std::string buffer = m_current_buffer;
-    const auto view = current_view_size();
-    auto end = view;
-    if (buffer.size() > view) {
-        std::string prefix = "";
-        std::string postfix = "";
-        if (current_view_offset() + view < buffer.size()) {
-            postfix = "\x1b[7m>\x1b[0m";
-        }
-        if (current_view_offset() + view > view) {
-            prefix = "\x1b[7m<\x1b[0m";
-        } else {
-            ++end;
-        }
-        buffer = prefix + buffer.substr(current_view_offset(), end) + postfix;
-    }
-    return buffer;
-}
-
-size_t lk::InteractiveBackend::current_view_cursor_pos() {
-    const auto view = current_view_size();
-    if (current_view_offset() + view > view) {
-        return m_cursor_pos + m_prompt.size() - current_view_offset() + 2;
-    } else {
-        return m_cursor_pos + m_prompt.size() - current_view_offset() + 1;
-    }
-}
-
-size_t lk::InteractiveBackend::current_view_offset() {
-    const auto view_size = current_view_size();
-    if (m_cursor_pos < view_size) {
-        return 0;
-    }
-    return m_cursor_pos - view_size;
-}
-size_t lk::InteractiveBackend::current_view_size() {
-    const auto w = impl::get_terminal_width() - m_prompt.size() - 1;
-    const auto view_size = w - 1;
-    return view_size;
-}
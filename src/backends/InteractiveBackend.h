@@ -1,12 +1,23 @@
 #pragma once
 
+#include "AutocompleteRequest.h"
 #include "Backend.h"
+#include "CompletionTree.h"
+#include "History.h"
+#include "impls.h"
+#include "KeyDecoder.h"
+#include "LineRenderer.h"
+#include "MpscQueue.h"
+#include "OptionalMutex.h"
+#include "SuggestionMenu.h"
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <limits>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <string>
 #include <thread>
 #include <vector>
@@ -15,27 +26,49 @@ namespace lk {
 
 class InteractiveBackend : public Backend {
 public:
-    explicit InteractiveBackend(const std::string& prompt = "");
+    explicit InteractiveBackend(const std::string& prompt = "", BackendMode mode = BackendMode::Threaded);
     InteractiveBackend(const InteractiveBackend&) = delete;
     ~InteractiveBackend() override;
 
     bool has_command() const override;
     void write(const std::string& str) override;
+    void write(std::string&& str) override;
+    void write(const char* data, size_t size) override;
     std::string get_command() override;
+    std::vector<std::string> get_commands() override;
+    size_t get_command_views(std::vector<CommandView>& views, size_t max) override;
+    bool wait_for_command() override;
+    bool wait_for_command(std::chrono::milliseconds timeout) override;
+    int command_fd() const override { return m_command_pipe.read_fd; }
+    bool poll_once(std::chrono::milliseconds timeout) override;
+    void process_input(const char* data, size_t size) override;
     bool history_enabled() const override { return m_history_enabled; }
     void enable_history() override { m_history_enabled = true; }
     void disable_history() override { m_history_enabled = false; }
     void set_history_limit(size_t count) override;
     size_t history_size() const override;
     void clear_history() override;
-    const std::vector<std::string>& history() const override { return m_history; }
-    void set_history(const std::vector<std::string>& history) override {
-        m_history = history;
-        m_history_index = 0;
-    }
+    void set_history_byte_limit(size_t bytes) override;
+    void set_history_ignore_duplicates(bool ignore) override;
+    bool set_history_file(const std::string& path) override;
+    std::vector<std::string> history() const override;
+    void set_history(const std::vector<std::string>& history) override;
     void set_prompt(const std::string& p) override;
     std::string prompt() const override;
 
+    void set_escape_timeout(std::chrono::milliseconds timeout) override;
+    void set_write_limit(size_t max_lines, size_t max_bytes, OverflowPolicy policy) override;
+    size_t dropped_lines() const override { return m_dropped_lines.load(); }
+    void set_render_rate(unsigned frames_per_second) override;
+    void set_output_buffering(size_t max_bytes, std::chrono::milliseconds max_delay) override;
+    void set_flush_on_termination_signals(bool enabled) override;
+    void flush() override;
+    void add_completion(const std::string& line) override;
+    void add_completions(const std::vector<std::string>& lines) override;
+    void clear_completions() override;
+    void enable_fuzzy_completion() override { m_fuzzy_completion = true; }
+    void disable_fuzzy_completion() override { m_fuzzy_completion = false; }
+
     // key_debug writes escape-sequenced keys to stderr
     void enable_key_debug() override;
     void disable_key_debug() override;
@@ -43,53 +76,155 @@ public:
 private:
     void io_thread_main();
     void input_thread_main();
+    void wake_io_thread();
+    bool poll_input(int timeout_ms);
+    void decode_input(const char* data, size_t size);
+    void handle_wakeup(bool woken);
+    void handle_keys();
+    void flush_output(bool final);
+    void collect_output();
+    void render_output(bool final);
+    std::chrono::steady_clock::time_point next_render() const;
+    void close_input();
+    bool over_write_limit(size_t lines, size_t bytes) const;
+    // counts a line of `size` bytes against the write limit, waiting for space if needed.
+    // returns false if the line is dropped instead.
+    bool reserve_write(size_t size);
+    void notify_written();
+    // printed lines' buffers are reused for new lines, see MpscQueue::pop()
+    std::string take_spare_line();
+    void recycle_line(std::string& line);
+    void trim_to_write_limit(std::vector<std::string>& lines);
 
     void add_to_history(const std::string& str);
+    // m_history_mutex must be held for these
     void go_back_in_history();
     void go_forward_in_history();
+    void show_history_entry();
+    void load_history_file(const impl::MappedFile& file);
+    void rewrite_history_file();
     void add_to_current_buffer(char c);
     void update_current_buffer_view();
-    void handle_escape_sequence(std::unique_lock<std::mutex>& guard);
+    void handle_key(const KeyEvent& key, std::unique_lock<OptionalMutex>& guard);
+    void handle_paste(const std::string& text, std::unique_lock<OptionalMutex>& guard);
+    void commit_current_buffer(std::unique_lock<OptionalMutex>& guard);
     void handle_backspace();
     void handle_delete();
-    void handle_tab(std::unique_lock<std::mutex>& guard, bool forward);
+    void handle_tab(std::unique_lock<OptionalMutex>& guard, bool forward);
+    bool handle_search_key(const KeyEvent& key, std::unique_lock<OptionalMutex>& guard);
+    void start_search();
+    void update_search(size_t before);
+    void end_search(bool accept);
+    void render_view(std::string& out);
     void clear_suggestions();
+    bool has_suggestions() const;
+    void apply_suggestion(size_t index);
+    size_t suggestion_count() const;
+    void show_suggestion_menu();
+    bool handle_menu_key(const KeyEvent& key);
+    void request_autocomplete(std::unique_lock<OptionalMutex>& guard);
+    bool receive_autocomplete_result();
+    void cancel_autocomplete_request();
     bool cancel_autocomplete_suggestion();
     void go_back();
     void go_forward();
     void go_right();
     void go_left();
+    void go_word_left();
+    void go_word_right();
     void go_to_begin();
     void go_to_end();
 
-    size_t current_view_size();
-    size_t current_view_offset();
-    std::string current_view();
-    size_t current_view_cursor_pos();
-
     std::string m_prompt;
 
+    const bool m_threaded;
     std::thread m_io_thread;
+    std::thread m_input_thread;
     std::atomic<bool> m_shutdown { false };
     bool m_key_debug { false };
 
-    mutable std::mutex m_to_write_mutex;
-    std::queue<std::string> m_to_write;
+    char m_input_buffer[4096];
+    KeyDecoder m_key_decoder;
+    std::vector<KeyEvent> m_keys;
+    bool m_stdin_closed { false }; // input thread / manual owner only
+    std::atomic<int> m_escape_timeout_ms { 50 };
+    // wakes the input thread, signaled on SIGWINCH and by autocomplete results
+    impl::WakeupPipe m_wakeup_pipe;
+
+    // writers never take m_to_write_mutex, it only guards the io thread going to sleep
+    MpscQueue<std::string> m_to_write;
+    std::atomic<bool> m_io_thread_waiting { false };
+    std::mutex m_to_write_mutex;
     std::condition_variable m_to_write_cond;
+    // output limits, see set_write_limit(). the pending counters are reserved by
+    // writers before pushing and released by the io thread after popping.
+    std::atomic<size_t> m_max_pending_lines { 0 };
+    std::atomic<size_t> m_max_pending_bytes { 0 };
+    std::atomic<OverflowPolicy> m_overflow_policy { OverflowPolicy::Block };
+    std::atomic<size_t> m_pending_lines { 0 };
+    std::atomic<size_t> m_pending_bytes { 0 };
+    std::atomic<size_t> m_dropped_lines { 0 };
+    // io thread / manual owner only
+    size_t m_reported_dropped_lines { 0 };
+    // collected but not yet rendered, see collect_output()
+    std::vector<std::string> m_output_lines;
+    size_t m_output_bytes { 0 };
+    std::vector<std::string> m_collected;
+    std::vector<std::string> m_spare_lines;
+    std::string m_output;
+    std::atomic<unsigned> m_render_rate { 0 };
+    std::chrono::steady_clock::time_point m_last_render;
+    // set by flush(), renders held back lines without waiting for the next frame
+    std::atomic<bool> m_flush_requested { false };
+    std::atomic<size_t> m_blocked_writers { 0 };
+    std::mutex m_space_mutex;
+    std::condition_variable m_space_cond;
     mutable std::mutex m_to_read_mutex;
-    std::queue<std::string> m_to_read;
+    std::condition_variable m_to_read_cond;
+    std::deque<std::string> m_to_read;
+    // what the last get_command_views() points into
+    std::vector<std::string> m_view_commands;
+    // signaled while m_to_read is non-empty
+    impl::WakeupPipe m_command_pipe;
+    bool m_input_closed { false };
     bool m_history_enabled { false };
-    mutable std::mutex m_history_mutex;
-    std::vector<std::string> m_history;
+    mutable OptionalMutex m_history_mutex;
+    History m_history;
     std::string m_history_temp_buffer;
     size_t m_history_index { 0 };
-    size_t m_history_limit = (std::numeric_limits<size_t>::max)() - 1;
-    std::mutex m_current_buffer_mutex;
+    // see set_history_file()
+    std::string m_history_file_path;
+    int m_history_fd { -1 };
+    size_t m_history_file_lines { 0 };
+    size_t m_history_file_bytes { 0 };
+    std::string m_history_line;
+    OptionalMutex m_current_buffer_mutex;
     std::string m_current_buffer;
+    // reverse history search (ctrl+r), see handle_search_key()
+    bool m_search_active { false };
+    std::string m_search_query;
+    size_t m_search_match { History::npos };
+    std::string m_search_prompt;
+    std::string m_buffer_before_search;
+    LineRenderer m_renderer;
+    std::string m_view_output;
+    // queried once and then only on resize, guarded by m_current_buffer_mutex
+    impl::TerminalSize m_terminal_size;
     int m_cursor_pos = 0;
+    OptionalMutex m_completions_mutex;
+    CompletionTree m_completions;
+    std::atomic<bool> m_fuzzy_completion { false };
+    // suggestions come either from m_completions or from on_autocomplete_async
+    CompletionTree::Matches m_completion_matches;
+    size_t m_completion_cursor { 0 };
     std::vector<std::string> m_autocomplete_suggestions;
     size_t m_autocomplete_index = 0;
     std::string m_buffer_before_autocomplete;
+    // shows the suggestions below the prompt while there's more than one
+    SuggestionMenu m_menu;
+    // the on_autocomplete_async request in flight, input thread / manual owner only
+    std::shared_ptr<AutocompleteMailbox> m_autocomplete_mailbox;
+    std::shared_ptr<AutocompleteRequest::State> m_autocomplete_request;
 };
 
 }
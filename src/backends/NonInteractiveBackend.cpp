@@ -0,0 +1,97 @@
+#include "NonInteractiveBackend.h"
+
+lk::NonInteractiveBackend::NonInteractiveBackend(const std::string& prompt, bool threaded)
+    : m_output(threaded)
+    , m_prompt(prompt) {
+}
+void lk::NonInteractiveBackend::write(const std::string& str) {
+    std::lock_guard<std::mutex> lock(m_out_mtx);
+    if (m_output.write(str.data(), str.size())) {
+        on_output_staged();
+    }
+    dispatch_write(str);
+}
+// the line is copied into the output buffer either way
+void lk::NonInteractiveBackend::write(std::string&& str) {
+    write(static_cast<const std::string&>(str));
+}
+void lk::NonInteractiveBackend::write(const char* data, size_t size) {
+    std::lock_guard<std::mutex> lock(m_out_mtx);
+    if (m_output.write(data, size)) {
+        on_output_staged();
+    }
+    // on_write and sinks take strings. this one is reused, so it stops allocating
+    // once it's as large as the longest line
+    m_written_line.assign(data, size);
+    dispatch_write(m_written_line);
+}
+bool lk::NonInteractiveBackend::history_enabled() const {
+    return false;
+}
+void lk::NonInteractiveBackend::enable_history() {
+}
+void lk::NonInteractiveBackend::disable_history() {
+}
+void lk::NonInteractiveBackend::set_history_limit(size_t) {
+}
+size_t lk::NonInteractiveBackend::history_size() const {
+    return 0;
+}
+void lk::NonInteractiveBackend::clear_history() {
+}
+void lk::NonInteractiveBackend::set_history_byte_limit(size_t) {
+}
+void lk::NonInteractiveBackend::set_history_ignore_duplicates(bool) {
+}
+bool lk::NonInteractiveBackend::set_history_file(const std::string&) {
+    return false;
+}
+std::vector<std::string> lk::NonInteractiveBackend::history() const {
+    return {};
+}
+void lk::NonInteractiveBackend::set_history(const std::vector<std::string>&) {
+}
+
+void lk::NonInteractiveBackend::set_prompt(const std::string& p) {
+    std::lock_guard<std::mutex> lock(m_prompt_mtx);
+    m_prompt = p;
+}
+
+std::string lk::NonInteractiveBackend::prompt() const {
+    std::lock_guard<std::mutex> lock(m_prompt_mtx);
+    return m_prompt;
+}
+void lk::NonInteractiveBackend::set_escape_timeout(std::chrono::milliseconds) {
+}
+// output is only staged for a moment, and never dropped, so there's nothing to limit
+void lk::NonInteractiveBackend::set_write_limit(size_t, size_t, OverflowPolicy) {
+}
+size_t lk::NonInteractiveBackend::dropped_lines() const {
+    return 0;
+}
+// there's no screen to update
+void lk::NonInteractiveBackend::set_render_rate(unsigned) {
+}
+void lk::NonInteractiveBackend::set_output_buffering(size_t max_bytes, std::chrono::milliseconds max_delay) {
+    m_output.set_limits(max_bytes, max_delay);
+}
+void lk::NonInteractiveBackend::set_flush_on_termination_signals(bool enabled) {
+    m_output.set_flush_on_termination_signals(enabled);
+}
+void lk::NonInteractiveBackend::flush() {
+    m_output.flush();
+}
+void lk::NonInteractiveBackend::add_completion(const std::string&) {
+}
+void lk::NonInteractiveBackend::add_completions(const std::vector<std::string>&) {
+}
+void lk::NonInteractiveBackend::clear_completions() {
+}
+void lk::NonInteractiveBackend::enable_fuzzy_completion() {
+}
+void lk::NonInteractiveBackend::disable_fuzzy_completion() {
+}
+void lk::NonInteractiveBackend::enable_key_debug() {
+}
+void lk::NonInteractiveBackend::disable_key_debug() {
+}
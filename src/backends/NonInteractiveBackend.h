@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Backend.h"
+#include "OutputBuffer.h"
+
+#include <mutex>
+
+namespace lk {
+
+// NonInteractiveBackend is what BufferedBackend and ScriptBackend share when
+// not on a terminal: written lines go to stdout in batches through an
+// OutputBuffer, and what only makes sense on a terminal (history, completion,
+// the prompt line) does nothing. Subclasses provide the input side.
+class NonInteractiveBackend : public Backend {
+public:
+    void write(const std::string& str) override;
+    void write(std::string&& str) override;
+    void write(const char* data, size_t size) override;
+    bool history_enabled() const override;
+    void enable_history() override;
+    void disable_history() override;
+    void set_history_limit(size_t count) override;
+    size_t history_size() const override;
+    void clear_history() override;
+    void set_history_byte_limit(size_t bytes) override;
+    void set_history_ignore_duplicates(bool ignore) override;
+    bool set_history_file(const std::string& path) override;
+    std::vector<std::string> history() const override;
+    void set_history(const std::vector<std::string>& history) override;
+    void set_prompt(const std::string& p) override;
+    std::string prompt() const override;
+    void set_escape_timeout(std::chrono::milliseconds timeout) override;
+    void set_write_limit(size_t max_lines, size_t max_bytes, OverflowPolicy policy) override;
+    size_t dropped_lines() const override;
+    void set_render_rate(unsigned frames_per_second) override;
+    void set_output_buffering(size_t max_bytes, std::chrono::milliseconds max_delay) override;
+    void set_flush_on_termination_signals(bool enabled) override;
+    void flush() override;
+    void add_completion(const std::string& line) override;
+    void add_completions(const std::vector<std::string>& lines) override;
+    void clear_completions() override;
+    void enable_fuzzy_completion() override;
+    void disable_fuzzy_completion() override;
+    void enable_key_debug() override;
+    void disable_key_debug() override;
+
+protected:
+    // with `threaded` false, the subclass has to call m_output.flush_if_due() regularly
+    NonInteractiveBackend(const std::string& prompt, bool threaded);
+    // called on write() when a line is staged and nothing else was, i.e. a flush is now due
+    // at some point. lets an owner waiting for input know that it has to wake up earlier.
+    virtual void on_output_staged() { }
+
+    // written lines, in batches
+    OutputBuffer m_output;
+
+private:
+    mutable std::mutex m_out_mtx {};
+    // see write(const char*, size_t)
+    std::string m_written_line;
+    mutable std::mutex m_prompt_mtx {};
+    std::string m_prompt;
+};
+
+}
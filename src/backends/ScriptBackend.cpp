@@ -0,0 +1,77 @@
+#include "ScriptBackend.h"
+#include <cstring>
+
+lk::ScriptBackend::ScriptBackend(const std::string& prompt, const std::string& path)
+    : NonInteractiveBackend(prompt, true) {
+    m_open = path.empty() ? impl::map_stdin(m_file) : impl::map_file(path, m_file);
+    impl::open_wakeup_pipe(m_command_pipe);
+    if (has_command()) {
+        impl::signal_wakeup_pipe(m_command_pipe);
+    }
+}
+lk::ScriptBackend::~ScriptBackend() {
+    impl::unmap_file(m_file);
+    impl::close_wakeup_pipe(m_command_pipe);
+}
+bool lk::ScriptBackend::next_command(CommandView& command) {
+    if (m_pos >= m_file.size) {
+        return false;
+    }
+    const char* begin = m_file.data + m_pos;
+    const size_t rest = m_file.size - m_pos;
+    // like std::getline, a last line without a newline still counts
+    const void* newline = std::memchr(begin, '\n', rest);
+    command.data = begin;
+    command.size = newline ? size_t(static_cast<const char*>(newline) - begin) : rest;
+    m_pos += command.size + 1;
+    return true;
+}
+void lk::ScriptBackend::drain_if_done() {
+    if (m_pos >= m_file.size) {
+        impl::drain_wakeup_pipe(m_command_pipe);
+    }
+}
+bool lk::ScriptBackend::has_command() const {
+    std::lock_guard<std::mutex> lock(m_cmd_mtx);
+    return m_pos < m_file.size;
+}
+std::string lk::ScriptBackend::get_command() {
+    std::lock_guard<std::mutex> lock(m_cmd_mtx);
+    CommandView command;
+    next_command(command);
+    drain_if_done();
+    return command.str();
+}
+std::vector<std::string> lk::ScriptBackend::get_commands() {
+    std::lock_guard<std::mutex> lock(m_cmd_mtx);
+    std::vector<std::string> commands;
+    CommandView command;
+    while (next_command(command)) {
+        commands.push_back(command.str());
+    }
+    drain_if_done();
+    return commands;
+}
+size_t lk::ScriptBackend::get_command_views(std::vector<CommandView>& views, size_t max) {
+    std::lock_guard<std::mutex> lock(m_cmd_mtx);
+    size_t count = 0;
+    CommandView command;
+    while (count < max && next_command(command)) {
+        views.push_back(command);
+        ++count;
+    }
+    drain_if_done();
+    return count;
+}
+// every command is there from the start, so there's nothing to wait for
+bool lk::ScriptBackend::wait_for_command() {
+    return has_command();
+}
+bool lk::ScriptBackend::wait_for_command(std::chrono::milliseconds) {
+    return has_command();
+}
+bool lk::ScriptBackend::poll_once(std::chrono::milliseconds) {
+    return false;
+}
+void lk::ScriptBackend::process_input(const char*, size_t) {
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "NonInteractiveBackend.h"
+#include "impls.h"
+
+#include <mutex>
+
+namespace lk {
+
+// ScriptBackend replays the commands in a file, one per line. The file is
+// memory-mapped and split into lines as they're taken, so get_command_views()
+// hands out views straight into the mapping, which stay valid for the lifetime
+// of the backend: replaying a script costs no allocation per command, only
+// reading the pages.
+// All commands are available right away, so nothing waits and on_command is
+// never called. Output is written in batches like BufferedBackend does.
+class ScriptBackend : public NonInteractiveBackend {
+public:
+    // an empty path maps the file stdin was redirected from
+    ScriptBackend(const std::string& prompt, const std::string& path);
+    ~ScriptBackend() override;
+
+    bool is_open() const { return m_open; }
+
+    bool has_command() const override;
+    std::string get_command() override;
+    std::vector<std::string> get_commands() override;
+    size_t get_command_views(std::vector<CommandView>& views, size_t max) override;
+    bool wait_for_command() override;
+    bool wait_for_command(std::chrono::milliseconds timeout) override;
+    int command_fd() const override { return m_command_pipe.read_fd; }
+    bool poll_once(std::chrono::milliseconds timeout) override;
+    void process_input(const char* data, size_t size) override;
+
+private:
+    // m_cmd_mtx must be held for both
+    bool next_command(CommandView& command);
+    void drain_if_done();
+
+    bool m_open { false };
+    impl::MappedFile m_file;
+    // where the next command starts
+    size_t m_pos { 0 };
+    mutable std::mutex m_cmd_mtx;
+    // signaled while commands are left
+    impl::WakeupPipe m_command_pipe;
+};
+
+}
@@ -2,17 +2,35 @@
 
 #include "backends/BufferedBackend.h"
 #include "backends/InteractiveBackend.h"
+#include "backends/ScriptBackend.h"
 #include "impls.h"
 
 #include <memory>
 #include <utility>
 
-Commandline::Commandline(const std::string& prompt) {
+Commandline::Commandline(const std::string& prompt, lk::BackendMode mode) {
     if (impl::is_interactive()) {
-        m_backend = std::unique_ptr<lk::Backend>(new lk::InteractiveBackend(prompt));
+        m_backend = std::unique_ptr<lk::Backend>(new lk::InteractiveBackend(prompt, mode));
     } else {
-        m_backend = std::unique_ptr<lk::Backend>(new lk::BufferedBackend(prompt));
+        m_backend = std::unique_ptr<lk::Backend>(new lk::BufferedBackend(prompt, mode));
     }
+    connect_backend();
+}
+
+Commandline::Commandline(std::unique_ptr<lk::Backend> backend)
+    : m_backend(std::move(backend)) {
+    connect_backend();
+}
+
+std::unique_ptr<Commandline> Commandline::from_script(const std::string& path, const std::string& prompt) {
+    std::unique_ptr<lk::ScriptBackend> script(new lk::ScriptBackend(prompt, path));
+    if (!script->is_open()) {
+        return nullptr;
+    }
+    return std::unique_ptr<Commandline>(new Commandline(std::move(script)));
+}
+
+void Commandline::connect_backend() {
     m_backend->on_command = [this](lk::Backend&) {
         if (on_command) {
             on_command(*this);
@@ -23,11 +41,27 @@ Commandline::Commandline(const std::string& prompt) {
             on_write(str);
         }
     };
-    m_backend->on_autocomplete = [this](lk::Backend&, std::string str, int n) {
-        if (on_autocomplete) {
-            return on_autocomplete(*this, std::move(str), n);
+    m_backend->on_autocomplete_async = [this](lk::Backend&, lk::AutocompleteRequest request) {
+        if (on_autocomplete_async) {
+            on_autocomplete_async(*this, std::move(request));
+        } else if (on_autocomplete) {
+            // completed right away, which the backend handles like a synchronous call
+            request.complete(on_autocomplete(*this, request.buffer(), request.cursor()));
         } else {
-            return std::vector<std::string> {};
+            request.complete({});
         }
     };
 }
+
+void Commandline::add_write_sink(lk::AsyncSink::Callback sink, size_t max_lines, size_t max_bytes, lk::OverflowPolicy policy) {
+    m_backend->add_sink(std::unique_ptr<lk::AsyncSink>(new lk::AsyncSink(std::move(sink), max_lines, max_bytes, policy)));
+}
+
+bool Commandline::add_file_sink(const std::string& path, bool append) {
+    lk::FileSink file(path, append);
+    if (!file.is_open()) {
+        return false;
+    }
+    add_write_sink(file);
+    return true;
+}
@@ -1,25 +1,96 @@
 #pragma once
 
+#include "WriteSink.h"
 #include "backends/Backend.h"
+#include <cstring>
 #include <memory>
 
 class Commandline final {
 public:
-    explicit Commandline(const std::string& prompt = "");
+    // with lk::BackendMode::Manual no threads are started, and the owner has to call
+    // poll_once() or process_input() regularly, see lk::BackendMode
+    explicit Commandline(const std::string& prompt = "", lk::BackendMode mode = lk::BackendMode::Threaded);
 
     bool has_command() const { return m_backend->has_command(); }
     void write(const std::string& str) { m_backend->write(str); }
+    // may take over the string's buffer instead of copying it
+    void write(std::string&& str) { m_backend->write(std::move(str)); }
+    void write(const char* str) { m_backend->write(str, std::strlen(str)); }
+    // writes `size` bytes from `data`, e.g. a std::string_view's data() and size()
+    void write(const char* data, size_t size) { m_backend->write(data, size); }
     std::string get_command() { return m_backend->get_command(); }
+    // takes all pending commands at once
+    std::vector<std::string> get_commands() { return m_backend->get_commands(); }
+    // takes up to `max` pending commands, appending views of them to `views`, and returns
+    // how many it took. the views stay valid until the next call. reusing `views`
+    // across calls avoids allocating per command where possible, see from_script().
+    size_t get_command_views(std::vector<lk::CommandView>& views, size_t max) { return m_backend->get_command_views(views, max); }
+    // blocks until a command is available. returns false if none will ever arrive,
+    // because the input was closed.
+    bool wait_for_command() { return m_backend->wait_for_command(); }
+    // like wait_for_command(), but also returns false once the timeout expires
+    bool wait_for_command(std::chrono::milliseconds timeout) { return m_backend->wait_for_command(timeout); }
+    // a file descriptor that is readable while commands are pending, for use with
+    // poll/epoll/select. reading commands makes it unreadable again once none are left.
+    // with edge-triggered epoll, take all commands (get_commands()) on each wake-up.
+    // -1 if not supported (windows).
+    int command_fd() const { return m_backend->command_fd(); }
+    // lk::BackendMode::Manual only: waits up to `timeout` for input, or for output written by
+    // other threads, handles it, and writes out pending output. returns true if any
+    // input was handled. once the input is closed, it only waits for output.
+    bool poll_once(std::chrono::milliseconds timeout) { return m_backend->poll_once(timeout); }
+    // lk::BackendMode::Manual only: handles input the owner read from stdin itself, and
+    // writes out pending output
+    void process_input(const char* data, size_t size) { m_backend->process_input(data, size); }
     bool history_enabled() const { return m_backend->history_enabled(); }
     void enable_history() { m_backend->enable_history(); }
     void disable_history() { m_backend->disable_history(); }
     void set_history_limit(size_t count) { m_backend->set_history_limit(count); }
+    // limits the total length of all history entries, 0 means unlimited (default)
+    void set_history_byte_limit(size_t bytes) { m_backend->set_history_byte_limit(bytes); }
+    // if enabled, a command equal to the previous one isn't added to the history again
+    void set_history_ignore_duplicates(bool ignore) { m_backend->set_history_ignore_duplicates(ignore); }
     size_t history_size() const { return m_backend->history_size(); }
     void clear_history() { m_backend->clear_history(); }
-    const std::vector<std::string>& history() const { return m_backend->history(); }
+    // loads the history from `path`, and appends every new entry to it from now on.
+    // the file is compacted once it grows well past the history limits.
+    bool set_history_file(const std::string& path) { return m_backend->set_history_file(path); }
+    // a copy of the history, oldest first
+    std::vector<std::string> history() const { return m_backend->history(); }
     void set_history(const std::vector<std::string>& history) { m_backend->set_history(history); }
     void set_prompt(const std::string& p) { m_backend->set_prompt(p); }
     std::string prompt() const { return m_backend->prompt(); }
+    // how long to wait for the rest of an escape sequence before treating ESC as a keypress
+    void set_escape_timeout(std::chrono::milliseconds timeout) { m_backend->set_escape_timeout(timeout); }
+    // limits how much output may be queued but not yet written, 0 means unlimited (default)
+    void set_write_limit(size_t max_lines, size_t max_bytes, lk::OverflowPolicy policy) { m_backend->set_write_limit(max_lines, max_bytes, policy); }
+    // how many lines were discarded because of the write limit
+    size_t dropped_lines() const { return m_backend->dropped_lines(); }
+    // caps how often the screen is updated with written lines, 0 means unlimited (default).
+    // lines written within one frame are printed together, with one prompt redraw.
+    // on_write and sinks still get every line as soon as it's written.
+    void set_render_rate(unsigned frames_per_second) { m_backend->set_render_rate(frames_per_second); }
+    // when not on a terminal (piped, redirected, scripts), written lines are written out in
+    // batches of up to `max_bytes`, at most `max_delay` after they were written. a max_bytes
+    // of 0 writes every line right away. defaults to 64 KiB and 50 ms. held back output is
+    // also written when the Commandline is destroyed, and when the process crashes.
+    void set_output_buffering(size_t max_bytes, std::chrono::milliseconds max_delay) { m_backend->set_output_buffering(max_bytes, max_delay); }
+    // also writes out held back output when the process is ended by SIGTERM, SIGINT, SIGHUP or
+    // SIGQUIT. off by default, since it installs process-wide signal handlers. signals the
+    // program handles or ignores itself are left alone. only the first Commandline's output
+    // is written on signals.
+    void set_flush_on_termination_signals(bool enabled) { m_backend->set_flush_on_termination_signals(enabled); }
+    // writes out all output that's held back, see set_output_buffering() and set_render_rate()
+    void flush() { m_backend->flush(); }
+    // registers a line of space-separated words for tab completion, e.g. "config reload".
+    // registered completions are tried before on_autocomplete and on_autocomplete_async.
+    void add_completion(const std::string& line) { m_backend->add_completion(line); }
+    // like add_completion() for each line, but cheaper for many lines
+    void add_completions(const std::vector<std::string>& lines) { m_backend->add_completions(lines); }
+    void clear_completions() { m_backend->clear_completions(); }
+    // matches registered completions fuzzily (like fzf) instead of by prefix, best match first
+    void enable_fuzzy_completion() { m_backend->enable_fuzzy_completion(); }
+    void disable_fuzzy_completion() { m_backend->disable_fuzzy_completion(); }
 
     // key_debug writes escape-sequenced keys to stderr
     void enable_key_debug() { m_backend->enable_key_debug(); }
@@ -31,9 +102,30 @@ public:
     // gets called when tab is pressed and new suggestions are requested
     std::function<std::vector<std::string>(Commandline&, std::string, int)> on_autocomplete { nullptr };
 
+    // like on_autocomplete, but the suggestions are delivered later through the request,
+    // so a slow lookup doesn't hold up typing. the callback itself should return quickly.
+    // takes precedence over on_autocomplete.
+    std::function<void(Commandline&, lk::AutocompleteRequest)> on_autocomplete_async { nullptr };
+
     // gets called on write(), for writing to a file or similar secondary logging system
     std::function<void(const std::string&)> on_write { nullptr };
 
+    // like on_write, but `sink` gets batches of written lines on its own thread, so that a
+    // slow consumer doesn't stall the terminal. it has its own queue limits, 0 means unlimited.
+    void add_write_sink(lk::AsyncSink::Callback sink, size_t max_lines = 0, size_t max_bytes = 0, lk::OverflowPolicy policy = lk::OverflowPolicy::Block);
+    // writes all written lines to the file at `path` through a sink, returns false if it can't be opened
+    bool add_file_sink(const std::string& path, bool append = false);
+
+    // a Commandline that replays the commands in the file at `path` instead of reading input,
+    // or the file stdin was redirected from if `path` is empty (`program < commands.txt`).
+    // the file is mapped, and with get_command_views() commands cost no allocation. all
+    // commands are available right away and on_command isn't called.
+    // returns nullptr if the file can't be mapped.
+    static std::unique_ptr<Commandline> from_script(const std::string& path, const std::string& prompt = "");
+
 private:
+    explicit Commandline(std::unique_ptr<lk::Backend> backend);
+    void connect_backend();
+
     std::unique_ptr<lk::Backend> m_backend;
 };
\ No newline at end of file
@@ -1,12 +1,85 @@
 #pragma once
 
+#include <cstddef>
+#include <string>
+
 namespace impl {
 bool is_interactive();
 void init_terminal();
 void reset_terminal();
-int getchar_no_echo();
+// a non-blocking pipe used as a pollable flag: readable while signaled.
+// not supported on windows, where both fds stay -1.
+struct WakeupPipe {
+    int read_fd { -1 };
+    int write_fd { -1 };
+};
+bool open_wakeup_pipe(WakeupPipe& pipe);
+void close_wakeup_pipe(WakeupPipe& pipe);
+void signal_wakeup_pipe(const WakeupPipe& pipe);
+void drain_wakeup_pipe(const WakeupPipe& pipe);
+// waits until `pipe` is signaled or timeout_ms elapsed (-1 waits forever), and returns
+// whether it was signaled. without a pipe (windows), only sleeps for timeout_ms.
+bool wait_for_wakeup_pipe(int timeout_ms, const WakeupPipe& pipe);
+// reads up to `size` bytes of raw input, blocking until at least one is available.
+// returns the number of bytes read, 0 on EOF, or -1 on error.
+int read_input(char* buf, size_t size);
+// waits until input is available, `wakeup_pipe` is signaled, the terminal was resized,
+// or timeout_ms elapsed (-1 waits forever). returns true if read_input() would not
+// block, and sets `woken` for the pipe or a resize. resizes signal the pipe passed
+// to watch_terminal_resize() on linux, and arrive as console input events on windows.
+bool wait_for_input(int timeout_ms, const WakeupPipe& wakeup_pipe, bool& woken);
+// without wakeup pipes (windows), waits that have to end early on some event
+// wait at most this long at a time, and check for the event in between
+const int wakeup_poll_interval_ms = 50;
+// like read_input() and wait_for_input(), but for a non-interactive stdin
+// (pipe or file), which on windows can't be read through the console functions
+int read_stdin(char* buf, size_t size);
+bool wait_for_stdin(int timeout_ms, const WakeupPipe& wakeup_pipe, bool& woken);
+// writes all of `data` to stdout, unbuffered, with as few syscalls as possible
+void write_output(const char* data, size_t size);
 bool is_shift_pressed(bool forward);
-int get_terminal_width();
+
+// signals `pipe` on every terminal resize, until unwatch_terminal_resize().
+// only one pipe can be watched at a time.
+bool watch_terminal_resize(const WakeupPipe& pipe);
+void unwatch_terminal_resize();
+// true if the terminal was resized (any number of times) since the last call
+bool take_terminal_resize();
+struct TerminalSize {
+    int width { 80 };
+    int height { 24 };
+};
+// queries the terminal, this is a syscall, so it should be cached
+TerminalSize get_terminal_size();
+
+// calls `handler` right before the process is killed by a crash signal or abort(), and with
+// `termination_signals` also by SIGTERM, SIGINT, SIGHUP or SIGQUIT. only signals that would
+// kill the process are hooked, not ones the program handles or ignores itself.
+// `handler` has to be async-signal-safe. only one handler can be set at a time, calling this
+// again changes which signals are hooked, nullptr removes it. signals the program has set its
+// own action for since aren't touched.
+void set_fatal_signal_handler(void (*handler)(), bool termination_signals);
+
+// a read-only memory mapping of a whole file
+struct MappedFile {
+    const char* data { nullptr };
+    size_t size { 0 };
+};
+// an empty file is mapped as { nullptr, 0 }
+bool map_file(const std::string& path, MappedFile& file);
+// maps the whole file stdin was redirected from. returns false if stdin isn't a regular file.
+bool map_stdin(MappedFile& file);
+void unmap_file(MappedFile& file);
+// opens `path` for appending, creating it if needed. returns -1 on error.
+int open_append_file(const std::string& path);
+// creates `path` for writing, readable only by the user, or truncates it if it exists.
+// returns -1 on error.
+int create_private_file(const std::string& path);
+// appends with a single write, so that concurrent appenders don't interleave
+bool append_file(int fd, const char* data, size_t size);
+void close_file(int fd);
+// atomically replaces `path` with `from`
+bool replace_file(const std::string& from, const std::string& path);
 }
 
 #if defined(PLATFORM_WINDOWS) && PLATFORM_WINDOWS
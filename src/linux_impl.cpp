@@ -1,10 +1,16 @@
 #include "impls.h"
 
 #if defined(PLATFORM_LINUX) && PLATFORM_LINUX
+#include <cerrno>
 #include <cstdio>
+#include <fcntl.h>
+#include <poll.h>
 #include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <termios.h>
 #include <unistd.h>
@@ -16,58 +22,321 @@ bool impl::is_interactive() {
 }
 
 void impl::init_terminal() {
-    tcgetattr(0, &s_original_termios);
+    tcgetattr(STDIN_FILENO, &s_original_termios);
+    // raw mode is entered once here and kept until reset_terminal(),
+    // instead of toggling termios around every single keystroke
+    struct termios raw = s_original_termios;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+    // bracketed paste, so that a paste arrives as one block instead of as keystrokes
+    std::fputs("\x1b[?2004h", stdout);
+    std::fflush(stdout);
 }
 
 void impl::reset_terminal() {
-    tcsetattr(0, TCSANOW, &s_original_termios);
+    tcsetattr(STDIN_FILENO, TCSANOW, &s_original_termios);
+    std::fputs("\x1b[?2004l", stdout);
     std::puts("\n"); // obligatory
 }
 
-namespace detail {
-static struct termios s_old_termios, s_current_termios;
+int impl::read_input(char* buf, size_t size) {
+    ssize_t ret;
+    do {
+        ret = read(STDIN_FILENO, buf, size);
+    } while (ret == -1 && errno == EINTR);
+    return int(ret);
+}
 
-static void init_termios(bool echo) {
-    tcgetattr(0, &s_old_termios);
-    s_current_termios = s_old_termios;
-    s_current_termios.c_lflag &= ~ICANON;
-    if (echo) {
-        s_current_termios.c_lflag |= ECHO;
-    } else {
-        s_current_termios.c_lflag &= ~ECHO;
-    }
-    tcsetattr(0, TCSANOW, &s_current_termios);
+bool impl::wait_for_input(int timeout_ms, const WakeupPipe& wakeup_pipe, bool& woken) {
+    struct pollfd pfds[2];
+    pfds[0].fd = STDIN_FILENO;
+    pfds[0].events = POLLIN;
+    pfds[0].revents = 0;
+    // poll ignores negative fds, so an unopened pipe is fine
+    pfds[1].fd = wakeup_pipe.read_fd;
+    pfds[1].events = POLLIN;
+    pfds[1].revents = 0;
+    int ret;
+    do {
+        ret = poll(pfds, 2, timeout_ms);
+    } while (ret == -1 && errno == EINTR);
+    woken = ret > 0 && pfds[1].revents != 0;
+    // hangups and errors count as "ready", so that the following read reports them
+    return ret > 0 && pfds[0].revents != 0;
 }
 
-static void reset_termios() {
-    tcsetattr(0, TCSANOW, &s_old_termios);
+bool impl::wait_for_wakeup_pipe(int timeout_ms, const WakeupPipe& pipe) {
+    struct pollfd pfd;
+    pfd.fd = pipe.read_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int ret;
+    do {
+        ret = poll(&pfd, 1, timeout_ms);
+    } while (ret == -1 && errno == EINTR);
+    return ret > 0 && pfd.revents != 0;
 }
 
-static int getch_(bool echo) {
-    int ch;
-    init_termios(echo);
-    ch = getchar();
-    reset_termios();
-    return ch;
+int impl::read_stdin(char* buf, size_t size) {
+    return read_input(buf, size);
 }
-} // namespace detail
 
-int impl::getchar_no_echo() {
-    return detail::getch_(false);
+bool impl::wait_for_stdin(int timeout_ms, const WakeupPipe& wakeup_pipe, bool& woken) {
+    return wait_for_input(timeout_ms, wakeup_pipe, woken);
+}
+
+void impl::write_output(const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t ret = write(STDOUT_FILENO, data, size);
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += ret;
+        size -= size_t(ret);
+    }
 }
 
 bool impl::is_shift_pressed(bool forward) {
     return forward;
 }
 
-int impl::get_terminal_width() {
+bool impl::open_wakeup_pipe(WakeupPipe& p) {
+    int fds[2];
+    if (pipe(fds) == -1) {
+        return false;
+    }
+    for (int fd : fds) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+    }
+    p.read_fd = fds[0];
+    p.write_fd = fds[1];
+    return true;
+}
+
+void impl::close_wakeup_pipe(WakeupPipe& p) {
+    if (p.read_fd != -1) {
+        close(p.read_fd);
+    }
+    if (p.write_fd != -1) {
+        close(p.write_fd);
+    }
+    p.read_fd = p.write_fd = -1;
+}
+
+void impl::signal_wakeup_pipe(const WakeupPipe& p) {
+    if (p.write_fd == -1) {
+        return;
+    }
+    const char c = 0;
+    ssize_t ret;
+    do {
+        ret = write(p.write_fd, &c, 1);
+    } while (ret == -1 && errno == EINTR);
+    // EAGAIN means the pipe is full, and so already readable
+}
+
+void impl::drain_wakeup_pipe(const WakeupPipe& p) {
+    if (p.read_fd == -1) {
+        return;
+    }
+    char buf[64];
+    for (;;) {
+        ssize_t ret = read(p.read_fd, buf, sizeof(buf));
+        if (ret == -1 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            break;
+        }
+    }
+}
+
+static volatile sig_atomic_t s_resize_fd = -1;
+static volatile sig_atomic_t s_resized = 0;
+static struct sigaction s_original_sigwinch;
+
+static void on_sigwinch(int) {
+    const int saved_errno = errno;
+    s_resized = 1;
+    const char c = 0;
+    // the pipe is non-blocking, and if it's full it's already signaled
+    ssize_t ret = write(s_resize_fd, &c, 1);
+    (void)ret;
+    errno = saved_errno;
+}
+
+bool impl::watch_terminal_resize(const WakeupPipe& pipe) {
+    if (pipe.write_fd == -1) {
+        return false;
+    }
+    s_resize_fd = pipe.write_fd;
+    struct sigaction action;
+    action.sa_handler = on_sigwinch;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    return sigaction(SIGWINCH, &action, &s_original_sigwinch) == 0;
+}
+
+void impl::unwatch_terminal_resize() {
+    sigaction(SIGWINCH, &s_original_sigwinch, nullptr);
+    s_resize_fd = -1;
+}
+
+bool impl::take_terminal_resize() {
+    if (!s_resized) {
+        return false;
+    }
+    // a resize right after this is seen by the caller's size query, and by the next call
+    s_resized = 0;
+    return true;
+}
+
+// crash signals first, then the ones that only end the process, which are hooked only on request
+static const int s_fatal_signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT, SIGTERM, SIGINT, SIGHUP, SIGQUIT };
+static const size_t s_fatal_signal_count = sizeof(s_fatal_signals) / sizeof(s_fatal_signals[0]);
+static const size_t s_first_termination_signal = 5;
+static bool s_fatal_signal_hooked[s_fatal_signal_count];
+static void (*volatile s_fatal_signal_handler)() = nullptr;
+
+static void on_fatal_signal(int sig) {
+    void (*handler)() = s_fatal_signal_handler;
+    if (handler) {
+        handler();
+    }
+    // only signals with the default action are hooked, so this kills the process like it would have
+    struct sigaction action {};
+    action.sa_handler = SIG_DFL;
+    sigemptyset(&action.sa_mask);
+    sigaction(sig, &action, nullptr);
+    raise(sig);
+}
+
+static void hook_fatal_signal(size_t i) {
+    if (s_fatal_signal_hooked[i]) {
+        return;
+    }
+    // signals the program handles or ignores itself (e.g. SIGHUP under nohup) are left alone
+    struct sigaction current;
+    if (sigaction(s_fatal_signals[i], nullptr, &current) != 0 || (current.sa_flags & SA_SIGINFO) || current.sa_handler != SIG_DFL) {
+        return;
+    }
+    struct sigaction action {};
+    action.sa_handler = on_fatal_signal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    s_fatal_signal_hooked[i] = sigaction(s_fatal_signals[i], &action, nullptr) == 0;
+}
+
+static void unhook_fatal_signal(size_t i) {
+    if (!s_fatal_signal_hooked[i]) {
+        return;
+    }
+    s_fatal_signal_hooked[i] = false;
+    // if the program set its own action since, that one stays
+    struct sigaction current;
+    if (sigaction(s_fatal_signals[i], nullptr, &current) != 0 || (current.sa_flags & SA_SIGINFO) || current.sa_handler != on_fatal_signal) {
+        return;
+    }
+    struct sigaction action {};
+    action.sa_handler = SIG_DFL;
+    sigemptyset(&action.sa_mask);
+    sigaction(s_fatal_signals[i], &action, nullptr);
+}
+
+void impl::set_fatal_signal_handler(void (*handler)(), bool termination_signals) {
+    s_fatal_signal_handler = handler;
+    for (size_t i = 0; i < s_fatal_signal_count; ++i) {
+        if (handler && (i < s_first_termination_signal || termination_signals)) {
+            hook_fatal_signal(i);
+        } else {
+            unhook_fatal_signal(i);
+        }
+    }
+}
+
+impl::TerminalSize impl::get_terminal_size() {
+    TerminalSize size;
     struct winsize w;
-    int ret = ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
-    if (ret == -1) {
-        return 80; // some sane default
-    } else {
-        return w.ws_col;
+    // some sane default if this fails, or if the terminal doesn't know its size
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) != -1 && w.ws_col > 0 && w.ws_row > 0) {
+        size.width = w.ws_col;
+        size.height = w.ws_row;
+    }
+    return size;
+}
+
+static bool map_fd(int fd, impl::MappedFile& file) {
+    file = impl::MappedFile {};
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    if (st.st_size > 0) {
+        void* data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+        // mapped files are read front to back, so the kernel can read ahead
+        madvise(data, size_t(st.st_size), MADV_SEQUENTIAL);
+        file.data = static_cast<const char*>(data);
+        file.size = size_t(st.st_size);
+    }
+    return true;
+}
+
+bool impl::map_file(const std::string& path, MappedFile& file) {
+    file = MappedFile {};
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
     }
+    const bool ok = map_fd(fd, file);
+    // the mapping stays valid after the fd is closed
+    close(fd);
+    return ok;
+}
+
+bool impl::map_stdin(MappedFile& file) {
+    return map_fd(STDIN_FILENO, file);
+}
+
+void impl::unmap_file(MappedFile& file) {
+    if (file.data) {
+        munmap(const_cast<char*>(file.data), file.size);
+    }
+    file = MappedFile {};
+}
+
+int impl::open_append_file(const std::string& path) {
+    return open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+}
+
+int impl::create_private_file(const std::string& path) {
+    return open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+}
+
+bool impl::append_file(int fd, const char* data, size_t size) {
+    ssize_t ret;
+    do {
+        ret = write(fd, data, size);
+    } while (ret == -1 && errno == EINTR);
+    return ret == ssize_t(size);
+}
+
+void impl::close_file(int fd) {
+    if (fd != -1) {
+        close(fd);
+    }
+}
+
+bool impl::replace_file(const std::string& from, const std::string& path) {
+    return rename(from.c_str(), path.c_str()) == 0;
 }
 
 #endif
@@ -2,8 +2,12 @@
 
 #if defined(PLATFORM_WINDOWS) && PLATFORM_WINDOWS
 #include <array>
+#include <atomic>
+#include <csignal>
 #include <conio.h>
+#include <fcntl.h>
 #include <io.h>
+#include <sys/stat.h>
 #include <stdio.h>
 #include <windows.h>
 
@@ -17,13 +21,91 @@ void impl::init_terminal() {
     GetConsoleMode(hConsole_c, &dwMode);
     dwMode |= ENABLE_VIRTUAL_TERMINAL_PROCESSING;
     SetConsoleMode(hConsole_c, dwMode);
+    // report resizes as input events, see wait_for_input()
+    HANDLE hInput = GetStdHandle(STD_INPUT_HANDLE);
+    GetConsoleMode(hInput, &dwMode);
+    SetConsoleMode(hInput, dwMode | ENABLE_WINDOW_INPUT);
 }
 
 void impl::reset_terminal() {
 }
 
-int impl::getchar_no_echo() {
-    return _getch();
+int impl::read_input(char* buf, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+    // block for the first key, then take whatever else is already waiting
+    int n = 0;
+    buf[n++] = char(_getch());
+    while (size_t(n) < size && _kbhit()) {
+        buf[n++] = char(_getch());
+    }
+    return n;
+}
+
+static std::atomic<bool> s_resized { false };
+
+bool impl::wait_for_input(int timeout_ms, const WakeupPipe&, bool& woken) {
+    woken = false;
+    HANDLE in = GetStdHandle(STD_INPUT_HANDLE);
+    DWORD timeout = timeout_ms < 0 ? INFINITE : DWORD(timeout_ms);
+    DWORD start = GetTickCount();
+    while (!_kbhit()) {
+        DWORD elapsed = GetTickCount() - start;
+        if (timeout != INFINITE && elapsed >= timeout) {
+            return false;
+        }
+        if (WaitForSingleObject(in, timeout == INFINITE ? INFINITE : timeout - elapsed) != WAIT_OBJECT_0) {
+            return false;
+        }
+        // the handle is also signaled for mouse, focus and key-up events, which
+        // _getch() never returns, so throw those away to avoid spinning
+        INPUT_RECORD record;
+        DWORD count = 0;
+        while (PeekConsoleInput(in, &record, 1, &count) && count > 0
+            && !(record.EventType == KEY_EVENT && record.Event.KeyEvent.bKeyDown)) {
+            if (record.EventType == WINDOW_BUFFER_SIZE_EVENT) {
+                s_resized.store(true);
+                woken = true;
+            }
+            ReadConsoleInput(in, &record, 1, &count);
+        }
+        if (woken) {
+            return _kbhit() != 0;
+        }
+    }
+    return true;
+}
+
+int impl::read_stdin(char* buf, size_t size) {
+    return _read(_fileno(stdin), buf, unsigned(size));
+}
+
+bool impl::wait_for_stdin(int timeout_ms, const WakeupPipe&, bool& woken) {
+    woken = false;
+    HANDLE in = GetStdHandle(STD_INPUT_HANDLE);
+    if (GetFileType(in) != FILE_TYPE_PIPE) {
+        // files never block
+        return true;
+    }
+    DWORD start = GetTickCount();
+    for (;;) {
+        DWORD available = 0;
+        // fails once the writer is gone, which the following read reports as EOF
+        if (!PeekNamedPipe(in, nullptr, 0, nullptr, &available, nullptr) || available > 0) {
+            return true;
+        }
+        if (timeout_ms >= 0 && GetTickCount() - start >= DWORD(timeout_ms)) {
+            return false;
+        }
+        // anonymous pipes can't be waited on
+        Sleep(1);
+    }
+}
+
+void impl::write_output(const char* data, size_t size) {
+    fwrite(data, 1, size, stdout);
+    fflush(stdout);
 }
 
 bool impl::is_shift_pressed(bool forward) {
@@ -34,14 +116,171 @@ bool impl::is_shift_pressed(bool forward) {
     return forward;
 }
 
-int impl::get_terminal_width() {
+// anonymous pipes can't be waited on together with sockets on windows, so there is no wakeup pipe
+bool impl::open_wakeup_pipe(WakeupPipe&) {
+    return false;
+}
+
+void impl::close_wakeup_pipe(WakeupPipe&) {
+}
+
+void impl::signal_wakeup_pipe(const WakeupPipe&) {
+}
+
+void impl::drain_wakeup_pipe(const WakeupPipe&) {
+}
+
+bool impl::wait_for_wakeup_pipe(int timeout_ms, const WakeupPipe&) {
+    Sleep(timeout_ms < 0 ? INFINITE : DWORD(timeout_ms));
+    return false;
+}
+
+// resizes are reported by wait_for_input()
+bool impl::watch_terminal_resize(const WakeupPipe&) {
+    return true;
+}
+
+void impl::unwatch_terminal_resize() {
+}
+
+bool impl::take_terminal_resize() {
+    return s_resized.exchange(false);
+}
+
+// crash signals first, then the ones that only end the process, which are hooked only on request
+static const int s_fatal_signals[] = { SIGSEGV, SIGFPE, SIGILL, SIGABRT, SIGTERM, SIGINT };
+static const size_t s_fatal_signal_count = sizeof(s_fatal_signals) / sizeof(s_fatal_signals[0]);
+static const size_t s_first_termination_signal = 4;
+static bool s_fatal_signal_hooked[s_fatal_signal_count];
+static void (*volatile s_fatal_signal_handler)() = nullptr;
+
+static void on_fatal_signal(int sig) {
+    void (*handler)() = s_fatal_signal_handler;
+    if (handler) {
+        handler();
+    }
+    // windows resets the handler to SIG_DFL before calling it, and only signals with the
+    // default action are hooked, so this kills the process like it would have
+    std::raise(sig);
+}
+
+static void hook_fatal_signal(size_t i) {
+    if (s_fatal_signal_hooked[i]) {
+        return;
+    }
+    // there's no way to look at the handler without replacing it. signals the program
+    // handles or ignores itself get their handler back right away.
+    void (*previous)(int) = std::signal(s_fatal_signals[i], on_fatal_signal);
+    if (previous == SIG_ERR) {
+        return;
+    }
+    if (previous != SIG_DFL) {
+        std::signal(s_fatal_signals[i], previous);
+        return;
+    }
+    s_fatal_signal_hooked[i] = true;
+}
+
+static void unhook_fatal_signal(size_t i) {
+    if (!s_fatal_signal_hooked[i]) {
+        return;
+    }
+    s_fatal_signal_hooked[i] = false;
+    // if the program set its own handler since, that one stays
+    void (*current)(int) = std::signal(s_fatal_signals[i], SIG_DFL);
+    if (current != on_fatal_signal && current != SIG_ERR) {
+        std::signal(s_fatal_signals[i], current);
+    }
+}
+
+void impl::set_fatal_signal_handler(void (*handler)(), bool termination_signals) {
+    s_fatal_signal_handler = handler;
+    for (size_t i = 0; i < s_fatal_signal_count; ++i) {
+        if (handler && (i < s_first_termination_signal || termination_signals)) {
+            hook_fatal_signal(i);
+        } else {
+            unhook_fatal_signal(i);
+        }
+    }
+}
+
+impl::TerminalSize impl::get_terminal_size() {
+    TerminalSize size;
     CONSOLE_SCREEN_BUFFER_INFO csbi;
-    int ret = GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi);
-    if (ret) {
-        return csbi.dwSize.Y;
-    } else {
-        return 80; // some sane default
+    // the visible window, not the whole scrollback buffer
+    if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi)) {
+        size.width = csbi.srWindow.Right - csbi.srWindow.Left + 1;
+        size.height = csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
+    }
+    return size;
+}
+
+static bool map_handle(HANDLE handle, impl::MappedFile& file) {
+    file = impl::MappedFile {};
+    if (GetFileType(handle) != FILE_TYPE_DISK) {
+        return false;
     }
+    LARGE_INTEGER size;
+    bool ok = GetFileSizeEx(handle, &size) != 0;
+    if (ok && size.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (data) {
+            file.data = static_cast<const char*>(data);
+            file.size = size_t(size.QuadPart);
+        } else {
+            ok = false;
+        }
+        // the view keeps the mapping alive
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+    }
+    return ok;
+}
+
+bool impl::map_file(const std::string& path, MappedFile& file) {
+    file = MappedFile {};
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    const bool ok = map_handle(handle, file);
+    CloseHandle(handle);
+    return ok;
+}
+
+bool impl::map_stdin(MappedFile& file) {
+    return map_handle(GetStdHandle(STD_INPUT_HANDLE), file);
+}
+
+void impl::unmap_file(MappedFile& file) {
+    if (file.data) {
+        UnmapViewOfFile(file.data);
+    }
+    file = MappedFile {};
+}
+
+int impl::open_append_file(const std::string& path) {
+    return _open(path.c_str(), _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+
+int impl::create_private_file(const std::string& path) {
+    return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+
+bool impl::append_file(int fd, const char* data, size_t size) {
+    return _write(fd, data, unsigned(size)) == int(size);
+}
+
+void impl::close_file(int fd) {
+    if (fd != -1) {
+        _close(fd);
+    }
+}
+
+bool impl::replace_file(const std::string& from, const std::string& path) {
+    return MoveFileExA(from.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
 }
 
 #endif
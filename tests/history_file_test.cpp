@@ -0,0 +1,84 @@
+#include "backends/InteractiveBackend.h"
+#include "test.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+mode_t mode_of(const std::string& path) {
+    struct stat st;
+    CHECK(stat(path.c_str(), &st) == 0);
+    return st.st_mode & 0777;
+}
+
+std::string contents_of(const std::string& path) {
+    std::string contents;
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    CHECK(file);
+    char buffer[256];
+    size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        contents.append(buffer, n);
+    }
+    std::fclose(file);
+    return contents;
+}
+
+// the history file is created private, and stays that way when it's rewritten,
+// whatever the umask would allow
+void test_rewrite_keeps_file_private(lk::Backend& backend, const std::string& path) {
+    umask(022);
+    CHECK(backend.set_history_file(path));
+    CHECK(mode_of(path) == 0600);
+    backend.set_history({ "first", "second" });
+    CHECK(mode_of(path) == 0600);
+    CHECK(contents_of(path) == "first\nsecond\n");
+    backend.clear_history();
+    CHECK(mode_of(path) == 0600);
+    CHECK(contents_of(path).empty());
+}
+}
+
+int main() {
+    char dir[] = "/tmp/history_file_test.XXXXXX";
+    CHECK(mkdtemp(dir));
+    const std::string path = std::string(dir) + "/history";
+
+    // stdin and stdout are a terminal nobody types into
+    const int master = posix_openpt(O_RDWR | O_NOCTTY);
+    CHECK(master >= 0);
+    CHECK(grantpt(master) == 0 && unlockpt(master) == 0);
+    const int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    CHECK(slave >= 0);
+    // the terminal's output is read on a thread, so that writes to it never block
+    std::thread reader([master] {
+        char buffer[4096];
+        while (read(master, buffer, sizeof(buffer)) > 0) {
+        }
+    });
+    const int saved_stdin = dup(STDIN_FILENO);
+    const int saved_stdout = dup(STDOUT_FILENO);
+    dup2(slave, STDIN_FILENO);
+    dup2(slave, STDOUT_FILENO);
+    {
+        lk::InteractiveBackend backend("> ", lk::BackendMode::Manual);
+        test_rewrite_keeps_file_private(backend, path);
+    }
+    dup2(saved_stdin, STDIN_FILENO);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdin);
+    close(saved_stdout);
+    // closing the last slave descriptor makes the reader's read() fail
+    close(slave);
+    reader.join();
+    close(master);
+
+    std::remove(path.c_str());
+    rmdir(dir);
+}
@@ -0,0 +1,134 @@
+#include "KeyDecoder.h"
+#include "test.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+using lk::Key;
+using lk::KeyDecoder;
+using lk::KeyEvent;
+
+std::vector<KeyEvent> decode(const std::string& input, bool windows_scan_codes = false) {
+    KeyDecoder decoder(windows_scan_codes);
+    std::vector<KeyEvent> events;
+    decoder.feed(input.data(), input.size(), events);
+    return events;
+}
+
+bool same(const std::vector<KeyEvent>& a, const std::vector<KeyEvent>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].key != b[i].key || a[i].mods != b[i].mods || a[i].ch != b[i].ch || a[i].text != b[i].text) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// input split at every position, and byte by byte, decodes to the same events as in one piece
+void check_splits(const std::string& input, bool windows_scan_codes = false) {
+    const std::vector<KeyEvent> whole = decode(input, windows_scan_codes);
+    for (size_t split = 1; split < input.size(); ++split) {
+        KeyDecoder decoder(windows_scan_codes);
+        std::vector<KeyEvent> events;
+        decoder.feed(input.data(), split, events);
+        decoder.feed(input.data() + split, input.size() - split, events);
+        CHECK(same(events, whole));
+    }
+    KeyDecoder decoder(windows_scan_codes);
+    std::vector<KeyEvent> events;
+    for (char c : input) {
+        decoder.feed(&c, 1, events);
+    }
+    CHECK(same(events, whole));
+}
+
+void test_split_sequences() {
+    auto events = decode("\x1b[A");
+    CHECK(events.size() == 1 && events[0].key == Key::Up);
+    check_splits("\x1b[A");
+
+    events = decode("\x1b[1;5C");
+    CHECK(events.size() == 1 && events[0].key == Key::Right && events[0].mods == lk::ModCtrl);
+    check_splits("\x1b[1;5C");
+
+    events = decode("\x1b[3~");
+    CHECK(events.size() == 1 && events[0].key == Key::Delete);
+    check_splits("\x1b[3~");
+
+    events = decode("\x1bOH");
+    CHECK(events.size() == 1 && events[0].key == Key::Home);
+    check_splits("\x1bOH");
+
+    events = decode("\x1b[Z");
+    CHECK(events.size() == 1 && events[0].key == Key::BackTab && (events[0].mods & lk::ModShift));
+    check_splits("\x1b[Z");
+
+    events = decode("\x1bx");
+    CHECK(events.size() == 1 && events[0].key == Key::Char && events[0].mods == lk::ModAlt && events[0].ch == 'x');
+    check_splits("\x1bx");
+
+    events = decode("\xe0H", true);
+    CHECK(events.size() == 1 && events[0].key == Key::Up);
+    check_splits("\xe0H", true);
+
+    // several keys in one read
+    events = decode("ab\x1b[D\x12\r");
+    CHECK(events.size() == 5);
+    CHECK(events[2].key == Key::Left);
+    CHECK(events[3].key == Key::Char && events[3].mods == lk::ModCtrl && events[3].ch == 'r');
+    CHECK(events[4].key == Key::Enter);
+    check_splits("ab\x1b[D\x12\r");
+}
+
+void test_pending_and_flush() {
+    KeyDecoder decoder;
+    std::vector<KeyEvent> events;
+    decoder.feed("\x1b", 1, events);
+    CHECK(events.empty() && decoder.pending());
+    // nothing followed in time, so it was the escape key
+    decoder.flush(events);
+    CHECK(events.size() == 1 && events[0].key == Key::Escape);
+    CHECK(!decoder.pending());
+
+    events.clear();
+    decoder.feed("\x1b[1;", 4, events);
+    CHECK(events.empty() && decoder.pending());
+    decoder.feed("5D", 2, events);
+    CHECK(events.size() == 1 && events[0].key == Key::Left && events[0].mods == lk::ModCtrl);
+    CHECK(!decoder.pending());
+
+    // an incomplete sequence that times out is reported as unknown
+    events.clear();
+    decoder.feed("\x1b[1", 3, events);
+    decoder.flush(events);
+    CHECK(events.size() == 1 && events[0].key == Key::Unknown);
+}
+
+void test_paste() {
+    const std::string paste = "\x1b[200~hello\x1b[2x world\x1b[201~";
+    auto events = decode(paste);
+    CHECK(events.size() == 1 && events[0].key == Key::Paste);
+    // the partial end marker inside is part of the text
+    CHECK(events[0].text == "hello\x1b[2x world");
+    check_splits(paste);
+
+    // waiting for the rest of a paste doesn't count as a pending escape sequence
+    KeyDecoder decoder;
+    std::vector<KeyEvent> events_so_far;
+    decoder.feed("\x1b[200~abc", 9, events_so_far);
+    CHECK(events_so_far.empty() && !decoder.pending());
+    decoder.flush(events_so_far);
+    decoder.feed("\x1b[201~", 6, events_so_far);
+    CHECK(events_so_far.size() == 1 && events_so_far[0].text == "abc");
+}
+}
+
+int main() {
+    test_split_sequences();
+    test_pending_and_flush();
+    test_paste();
+}
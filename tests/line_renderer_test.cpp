@@ -0,0 +1,143 @@
+#include "LineRenderer.h"
+#include "test.h"
+
+#include <cstdlib>
+#include <string>
+
+namespace {
+// the line of a terminal, with what the renderer sends handled like xterm does it:
+// writing into the last column leaves the cursor there until the next character
+// wraps it onto the next line
+class TerminalLine {
+public:
+    explicit TerminalLine(size_t width)
+        : m_width(width)
+        , m_line(width, ' ') {
+    }
+
+    void feed(const std::string& out) {
+        for (size_t i = 0; i < out.size(); ++i) {
+            if (out[i] == '\x1b') {
+                CHECK(i + 1 < out.size() && out[i + 1] == '[');
+                size_t end = i + 2;
+                while (end < out.size() && (out[end] >= '0' && out[end] <= '9')) {
+                    ++end;
+                }
+                CHECK(end < out.size());
+                const size_t n = end > i + 2 ? size_t(std::atoi(out.c_str() + i + 2)) : 0;
+                csi(n, out[end]);
+                i = end;
+            } else if (out[i] == '\b') {
+                m_pending_wrap = false;
+                if (m_cursor > 0) {
+                    --m_cursor;
+                }
+            } else {
+                // nothing is ever meant to go onto the next line
+                CHECK(!m_pending_wrap);
+                m_line[m_cursor] = out[i];
+                if (m_cursor + 1 == m_width) {
+                    m_pending_wrap = true;
+                } else {
+                    ++m_cursor;
+                }
+            }
+        }
+    }
+
+    const std::string& line() const { return m_line; }
+    size_t cursor() const { return m_cursor; }
+
+private:
+    void csi(size_t n, char final) {
+        m_pending_wrap = false;
+        switch (final) {
+        case 'C':
+            m_cursor = m_cursor + n < m_width ? m_cursor + n : m_width - 1;
+            break;
+        case 'D':
+            m_cursor = m_cursor > n ? m_cursor - n : 0;
+            break;
+        case 'G':
+            m_cursor = n > 0 ? n - 1 : 0;
+            break;
+        case 'K':
+            if (n == 2) {
+                m_line.assign(m_width, ' ');
+            } else {
+                m_line.replace(m_cursor, std::string::npos, m_width - m_cursor, ' ');
+            }
+            break;
+        case '@':
+            m_line.insert(m_cursor, n, ' ');
+            m_line.resize(m_width);
+            break;
+        case 'P':
+            m_line.erase(m_cursor, n);
+            m_line.resize(m_width, ' ');
+            break;
+        case 'm':
+            break;
+        default:
+            CHECK(!"unexpected escape sequence");
+        }
+    }
+
+    size_t m_width;
+    std::string m_line;
+    size_t m_cursor { 0 };
+    bool m_pending_wrap { false };
+};
+
+const std::string prompt = "> ";
+const size_t width = 20;
+
+// draws the line through `renderer` onto `terminal`, and checks that it ends up
+// like a fresh renderer drawing it on a fresh terminal, with the cursor where
+// the renderer thinks it is
+void check_render(lk::LineRenderer& renderer, TerminalLine& terminal, const std::string& buffer, size_t cursor) {
+    std::string out;
+    renderer.render(prompt, buffer, cursor, width, out);
+    terminal.feed(out);
+    CHECK(terminal.cursor() == renderer.cursor_column());
+
+    lk::LineRenderer fresh;
+    TerminalLine fresh_terminal(width);
+    out.clear();
+    fresh.render(prompt, buffer, cursor, width, out);
+    fresh_terminal.feed(out);
+    CHECK(fresh_terminal.cursor() == fresh.cursor_column());
+    CHECK(terminal.line() == fresh_terminal.line());
+    CHECK(terminal.cursor() == fresh_terminal.cursor());
+}
+
+// a line longer than the terminal is scrolled through, edited in the middle and at
+// both ends, and jumped through with home and end
+void test_long_line() {
+    lk::LineRenderer renderer;
+    TerminalLine terminal(width);
+    std::string buffer;
+    for (char c = 'a'; c <= 'z'; ++c) {
+        buffer += c;
+        check_render(renderer, terminal, buffer, buffer.size());
+    }
+    check_render(renderer, terminal, buffer, 0);
+    for (size_t cursor = 1; cursor <= buffer.size(); ++cursor) {
+        check_render(renderer, terminal, buffer, cursor);
+    }
+    check_render(renderer, terminal, buffer, 0);
+    for (size_t cursor = 0; cursor < 10; ++cursor) {
+        buffer.insert(cursor, 1, '_');
+        check_render(renderer, terminal, buffer, cursor + 1);
+    }
+    while (buffer.size() > 5) {
+        buffer.erase(5, 1);
+        check_render(renderer, terminal, buffer, 5);
+    }
+    check_render(renderer, terminal, buffer, buffer.size());
+}
+}
+
+int main() {
+    test_long_line();
+}
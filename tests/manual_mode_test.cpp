@@ -0,0 +1,205 @@
+#include "backends/BufferedBackend.h"
+#include "backends/InteractiveBackend.h"
+#include "test.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+// reads from `fd` on a thread until `text` shows up
+class OutputWatcher {
+public:
+    OutputWatcher(int fd, const std::string& text)
+        : m_thread([this, fd, text] {
+            std::string output;
+            char buffer[4096];
+            ssize_t n;
+            while (output.find(text) == std::string::npos && (n = read(fd, buffer, sizeof(buffer))) > 0) {
+                output.append(buffer, size_t(n));
+            }
+            m_seen.store(output.find(text) != std::string::npos);
+        }) {
+    }
+    ~OutputWatcher() { m_thread.join(); }
+    bool seen() const { return m_seen.load(); }
+
+private:
+    std::atomic<bool> m_seen { false };
+    std::thread m_thread;
+};
+
+// poll_once() waits for input without a timeout while another thread writes, and
+// has to wake up and write the line out in time. afterwards it's released with
+// input on `input_fd`, which it would otherwise wait for forever.
+void check_write_wakes_poll(lk::Backend& backend, const OutputWatcher& watcher, int input_fd) {
+    bool seen_before_input = false;
+    std::thread writer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        backend.write("written from another thread");
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (!watcher.seen() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        seen_before_input = watcher.seen();
+        CHECK(::write(input_fd, "\n", 1) == 1);
+    });
+    while (!backend.poll_once(std::chrono::milliseconds(-1))) {
+    }
+    writer.join();
+    CHECK(seen_before_input);
+}
+
+// once stdin is closed, poll_once() still waits without a timeout instead of
+// returning right away, and writes from another thread still wake it up
+void check_write_wakes_poll_after_eof(lk::Backend& backend, const OutputWatcher& watcher) {
+    // reads the end of the input
+    backend.poll_once(std::chrono::milliseconds(0));
+    bool seen_before_done = false;
+    std::atomic<bool> done { false };
+    std::thread writer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        backend.write("written from another thread");
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (!watcher.seen() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        seen_before_done = watcher.seen();
+        done.store(true);
+        // wakes up the last poll_once()
+        backend.write("done");
+    });
+    // each write takes a call or two to be written out, a busy loop takes many more
+    int calls = 0;
+    while (!done.load()) {
+        CHECK(++calls < 20);
+        backend.poll_once(std::chrono::milliseconds(-1));
+    }
+    writer.join();
+    CHECK(seen_before_done);
+}
+
+// stdin is a pipe nothing arrives on, stdout a pipe that's watched
+void test_buffered() {
+    int in[2];
+    int out[2];
+    CHECK(pipe(in) == 0 && pipe(out) == 0);
+    const int saved_stdin = dup(STDIN_FILENO);
+    const int saved_stdout = dup(STDOUT_FILENO);
+    dup2(in[0], STDIN_FILENO);
+    dup2(out[1], STDOUT_FILENO);
+    close(out[1]);
+    {
+        OutputWatcher watcher(out[0], "written from another thread\n");
+        {
+            lk::BufferedBackend backend("> ", lk::BackendMode::Manual);
+            check_write_wakes_poll(backend, watcher, in[1]);
+        }
+        // the watcher stops at EOF if the line never came
+        dup2(saved_stdout, STDOUT_FILENO);
+    }
+    dup2(saved_stdin, STDIN_FILENO);
+    close(saved_stdin);
+    close(saved_stdout);
+    close(in[0]);
+    close(in[1]);
+    close(out[0]);
+}
+
+// stdin is a pipe that's already closed, stdout a pipe that's watched
+void test_buffered_eof() {
+    int in[2];
+    int out[2];
+    CHECK(pipe(in) == 0 && pipe(out) == 0);
+    close(in[1]);
+    const int saved_stdin = dup(STDIN_FILENO);
+    const int saved_stdout = dup(STDOUT_FILENO);
+    dup2(in[0], STDIN_FILENO);
+    dup2(out[1], STDOUT_FILENO);
+    close(out[1]);
+    {
+        OutputWatcher watcher(out[0], "written from another thread\n");
+        {
+            lk::BufferedBackend backend("> ", lk::BackendMode::Manual);
+            check_write_wakes_poll_after_eof(backend, watcher);
+        }
+        dup2(saved_stdout, STDOUT_FILENO);
+    }
+    dup2(saved_stdin, STDIN_FILENO);
+    close(saved_stdin);
+    close(saved_stdout);
+    close(in[0]);
+    close(out[0]);
+}
+
+// stdin and stdout are a terminal nobody types into
+void test_interactive() {
+    const int master = posix_openpt(O_RDWR | O_NOCTTY);
+    CHECK(master >= 0);
+    CHECK(grantpt(master) == 0 && unlockpt(master) == 0);
+    const int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    CHECK(slave >= 0);
+    const int saved_stdin = dup(STDIN_FILENO);
+    const int saved_stdout = dup(STDOUT_FILENO);
+    dup2(slave, STDIN_FILENO);
+    dup2(slave, STDOUT_FILENO);
+    {
+        OutputWatcher watcher(master, "written from another thread");
+        {
+            lk::InteractiveBackend backend("> ", lk::BackendMode::Manual);
+            check_write_wakes_poll(backend, watcher, master);
+        }
+        dup2(saved_stdin, STDIN_FILENO);
+        dup2(saved_stdout, STDOUT_FILENO);
+        // closing the last slave descriptor makes the watcher's read() fail
+        close(slave);
+    }
+    close(saved_stdin);
+    close(saved_stdout);
+    close(master);
+}
+
+// stdin is a pipe that's already closed, stdout a terminal
+void test_interactive_eof() {
+    int in[2];
+    CHECK(pipe(in) == 0);
+    close(in[1]);
+    const int master = posix_openpt(O_RDWR | O_NOCTTY);
+    CHECK(master >= 0);
+    CHECK(grantpt(master) == 0 && unlockpt(master) == 0);
+    const int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    CHECK(slave >= 0);
+    const int saved_stdin = dup(STDIN_FILENO);
+    const int saved_stdout = dup(STDOUT_FILENO);
+    dup2(in[0], STDIN_FILENO);
+    dup2(slave, STDOUT_FILENO);
+    {
+        OutputWatcher watcher(master, "written from another thread");
+        {
+            lk::InteractiveBackend backend("> ", lk::BackendMode::Manual);
+            check_write_wakes_poll_after_eof(backend, watcher);
+        }
+        dup2(saved_stdin, STDIN_FILENO);
+        dup2(saved_stdout, STDOUT_FILENO);
+        // closing the last slave descriptor makes the watcher's read() fail
+        close(slave);
+    }
+    close(saved_stdin);
+    close(saved_stdout);
+    close(in[0]);
+    close(master);
+}
+}
+
+int main() {
+    // if something else goes wrong and poll_once() never returns, fail instead of hanging
+    alarm(10);
+    test_buffered();
+    test_buffered_eof();
+    test_interactive();
+    test_interactive_eof();
+}
@@ -0,0 +1,127 @@
+#include "commandline.h"
+#include "test.h"
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+void (*handler_of(int sig))(int) {
+    struct sigaction action;
+    CHECK(sigaction(sig, nullptr, &action) == 0);
+    return action.sa_handler;
+}
+
+void on_signal(int) {
+}
+
+// runs `child` in a child process with stdout piped, and returns what it wrote.
+// `status` is the child's wait status.
+template<typename F>
+std::string run_child(F child, int& status) {
+    int fds[2];
+    CHECK(pipe(fds) == 0);
+    const pid_t pid = fork();
+    CHECK(pid >= 0);
+    if (pid == 0) {
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        child();
+        _exit(0);
+    }
+    close(fds[1]);
+    std::string output;
+    char buffer[256];
+    ssize_t n;
+    while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) {
+        output.append(buffer, size_t(n));
+    }
+    close(fds[0]);
+    CHECK(waitpid(pid, &status, 0) == pid);
+    return output;
+}
+
+// crash signals flush held back output, and still kill the process
+void test_crash_flushes() {
+    int status = 0;
+    const std::string output = run_child([] {
+        Commandline com;
+        com.write("before abort");
+        std::abort();
+    },
+        status);
+    CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+    CHECK(output == "before abort\n");
+}
+
+// termination signals only flush once asked to
+void test_termination_opt_in() {
+    int status = 0;
+    std::string output = run_child([] {
+        Commandline com;
+        com.write("not flushed");
+        raise(SIGTERM);
+    },
+        status);
+    CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGTERM);
+    CHECK(output.empty());
+
+    output = run_child([] {
+        Commandline com;
+        com.set_flush_on_termination_signals(true);
+        com.write("flushed");
+        raise(SIGTERM);
+    },
+        status);
+    CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGTERM);
+    CHECK(output == "flushed\n");
+}
+
+// signals that are ignored or handled by the program aren't touched, and handlers
+// the program sets while a Commandline is alive stay when it's destroyed
+void test_program_actions_kept() {
+    signal(SIGHUP, SIG_IGN);
+    signal(SIGINT, on_signal);
+    {
+        Commandline com;
+        com.set_flush_on_termination_signals(true);
+        CHECK(handler_of(SIGHUP) == SIG_IGN);
+        CHECK(handler_of(SIGINT) == on_signal);
+        CHECK(handler_of(SIGTERM) != SIG_DFL);
+        signal(SIGTERM, on_signal);
+        signal(SIGSEGV, on_signal);
+    }
+    CHECK(handler_of(SIGHUP) == SIG_IGN);
+    CHECK(handler_of(SIGINT) == on_signal);
+    CHECK(handler_of(SIGTERM) == on_signal);
+    CHECK(handler_of(SIGSEGV) == on_signal);
+    signal(SIGHUP, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGSEGV, SIG_DFL);
+
+    // and everything that was hooked is back to the default
+    {
+        Commandline com;
+        com.set_flush_on_termination_signals(true);
+        CHECK(handler_of(SIGABRT) != SIG_DFL);
+        CHECK(handler_of(SIGQUIT) != SIG_DFL);
+        // turning it off again unhooks only the termination signals
+        com.set_flush_on_termination_signals(false);
+        CHECK(handler_of(SIGQUIT) == SIG_DFL);
+        CHECK(handler_of(SIGABRT) != SIG_DFL);
+    }
+    CHECK(handler_of(SIGABRT) == SIG_DFL);
+}
+}
+
+int main() {
+    // the Commandlines mustn't be interactive, and their input ends right away
+    CHECK(std::freopen("/dev/null", "r", stdin));
+    test_crash_flushes();
+    test_termination_opt_in();
+    test_program_actions_kept();
+}
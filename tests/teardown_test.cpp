@@ -0,0 +1,154 @@
+#include "commandline.h"
+#include "test.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+int thread_count() {
+    int count = 0;
+    DIR* dir = opendir("/proc/self/task");
+    CHECK(dir);
+    while (dirent* entry = readdir(dir)) {
+        count += entry->d_name[0] != '.';
+    }
+    closedir(dir);
+    return count;
+}
+
+// reads from `fd` on a thread until it fails, and collects what was read
+class OutputCollector {
+public:
+    explicit OutputCollector(int fd)
+        : m_thread([this, fd] {
+            char buffer[4096];
+            ssize_t n;
+            while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_output.append(buffer, size_t(n));
+            }
+        }) {
+    }
+    ~OutputCollector() { m_thread.join(); }
+
+    // waits up to a second for `text` to show up, and returns everything collected
+    // so far, which is then forgotten
+    std::string take(const std::string& text) {
+        const auto deadline = Clock::now() + std::chrono::seconds(1);
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_output.find(text) != std::string::npos || Clock::now() > deadline) {
+                    std::string output;
+                    output.swap(m_output);
+                    return output;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+private:
+    std::mutex m_mutex;
+    std::string m_output;
+    std::thread m_thread;
+};
+
+// whether "line 0" to "line <count - 1>" all appear in `output`, in order
+bool has_lines(const std::string& output, int count) {
+    size_t pos = 0;
+    for (int line = 0; line < count; ++line) {
+        const std::string text = "line " + std::to_string(line);
+        // "line 1" mustn't be found in "line 10"
+        do {
+            pos = output.find(text, pos);
+            if (pos == std::string::npos) {
+                return false;
+            }
+            pos += text.size();
+        } while (pos < output.size() && output[pos] >= '0' && output[pos] <= '9');
+    }
+    return true;
+}
+
+// constructs and destroys a Commandline on whatever stdin and stdout are, while
+// nothing ever arrives on stdin, so the input thread is blocked waiting for it.
+// all lines written before it's destroyed have to reach stdout.
+void check_teardown(OutputCollector& collector) {
+    const int threads_before = thread_count();
+    for (int i = 0; i < 20; ++i) {
+        std::unique_ptr<Commandline> com(new Commandline("> "));
+        for (int line = 0; line < 100; ++line) {
+            com->write("line " + std::to_string(line));
+        }
+        const auto start = Clock::now();
+        com.reset();
+        CHECK(Clock::now() - start < std::chrono::seconds(1));
+        CHECK(thread_count() == threads_before);
+        CHECK(has_lines(collector.take("line 99"), 100));
+    }
+}
+
+// stdin is a pipe that's never written to or closed, stdout another pipe
+void test_buffered() {
+    int in[2];
+    int out[2];
+    CHECK(pipe(in) == 0 && pipe(out) == 0);
+    const int saved_stdin = dup(STDIN_FILENO);
+    const int saved_stdout = dup(STDOUT_FILENO);
+    dup2(in[0], STDIN_FILENO);
+    dup2(out[1], STDOUT_FILENO);
+    close(out[1]);
+    {
+        OutputCollector collector(out[0]);
+        check_teardown(collector);
+        // the collector stops at EOF
+        dup2(saved_stdout, STDOUT_FILENO);
+    }
+    dup2(saved_stdin, STDIN_FILENO);
+    close(saved_stdin);
+    close(saved_stdout);
+    close(in[0]);
+    close(in[1]);
+    close(out[0]);
+}
+
+// stdin and stdout are a terminal nobody types into
+void test_interactive() {
+    const int master = posix_openpt(O_RDWR | O_NOCTTY);
+    CHECK(master >= 0);
+    CHECK(grantpt(master) == 0 && unlockpt(master) == 0);
+    const int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    CHECK(slave >= 0);
+    const int saved_stdin = dup(STDIN_FILENO);
+    const int saved_stdout = dup(STDOUT_FILENO);
+    dup2(slave, STDIN_FILENO);
+    dup2(slave, STDOUT_FILENO);
+    {
+        // the terminal's output is collected on a thread, which also keeps writes to it from blocking
+        OutputCollector collector(master);
+        check_teardown(collector);
+        dup2(saved_stdin, STDIN_FILENO);
+        dup2(saved_stdout, STDOUT_FILENO);
+        // closing the last slave descriptor makes the collector's read() fail
+        close(slave);
+    }
+    close(saved_stdin);
+    close(saved_stdout);
+    close(master);
+}
+}
+
+int main() {
+    test_buffered();
+    test_interactive();
+}
@@ -0,0 +1,128 @@
+#include "backends/BufferedBackend.h"
+#include "backends/InteractiveBackend.h"
+#include "test.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <fcntl.h>
+#include <new>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+// every allocation in the process is counted
+static std::atomic<size_t> s_allocations { 0 };
+
+void* operator new(size_t size) {
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+namespace {
+const std::string line(100, 'x');
+const int lines_per_round = 100;
+
+// writes a round of lines in every way there is. the moved lines are set up
+// beforehand, so that only what write() allocates is counted.
+void write_round(lk::Backend& backend, std::vector<std::string>& moved) {
+    for (int i = 0; i < lines_per_round; ++i) {
+        backend.write(line);
+        backend.write(line.data(), line.size());
+        backend.write(std::move(moved[i]));
+    }
+}
+
+void prepare(std::vector<std::string>& moved) {
+    for (auto& str : moved) {
+        str.assign(line);
+    }
+}
+
+// once the buffers and queues have grown to what a round needs, writing more
+// rounds mustn't allocate, and neither must writing them out
+void check_no_allocations(lk::Backend& backend) {
+    std::vector<std::string> moved(lines_per_round);
+    for (int round = 0; round < 10; ++round) {
+        prepare(moved);
+        write_round(backend, moved);
+        backend.flush();
+    }
+    for (int round = 0; round < 10; ++round) {
+        prepare(moved);
+        size_t before = s_allocations.load();
+        write_round(backend, moved);
+        CHECK(s_allocations.load() == before);
+        before = s_allocations.load();
+        backend.flush();
+        CHECK(s_allocations.load() == before);
+    }
+}
+
+// stdin is a pipe nothing arrives on, stdout is /dev/null
+void test_buffered() {
+    int fds[2];
+    CHECK(pipe(fds) == 0);
+    const int null = open("/dev/null", O_WRONLY);
+    CHECK(null >= 0);
+    const int saved_stdin = dup(STDIN_FILENO);
+    const int saved_stdout = dup(STDOUT_FILENO);
+    dup2(fds[0], STDIN_FILENO);
+    dup2(null, STDOUT_FILENO);
+    {
+        lk::BufferedBackend backend("> ", lk::BackendMode::Manual);
+        check_no_allocations(backend);
+    }
+    dup2(saved_stdin, STDIN_FILENO);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdin);
+    close(saved_stdout);
+    close(null);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// stdin and stdout are a terminal nobody types into
+void test_interactive() {
+    const int master = posix_openpt(O_RDWR | O_NOCTTY);
+    CHECK(master >= 0);
+    CHECK(grantpt(master) == 0 && unlockpt(master) == 0);
+    const int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    CHECK(slave >= 0);
+    // the terminal's output is read on a thread, so that writes to it never block
+    std::thread reader([master] {
+        char buffer[4096];
+        while (read(master, buffer, sizeof(buffer)) > 0) {
+        }
+    });
+    const int saved_stdin = dup(STDIN_FILENO);
+    const int saved_stdout = dup(STDOUT_FILENO);
+    dup2(slave, STDIN_FILENO);
+    dup2(slave, STDOUT_FILENO);
+    {
+        lk::InteractiveBackend backend("> ", lk::BackendMode::Manual);
+        check_no_allocations(backend);
+    }
+    dup2(saved_stdin, STDIN_FILENO);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdin);
+    close(saved_stdout);
+    // closing the last slave descriptor makes the reader's read() fail
+    close(slave);
+    reader.join();
+    close(master);
+}
+}
+
+int main() {
+    test_buffered();
+    test_interactive();
+}